@@ -1,8 +1,22 @@
 """New LangGraph Agent.
 
 This module defines a custom graph.
+
+Submodules load on first access, so importing the package (e.g. for
+`agent.batching`) doesn't pull in LangGraph and compile the graph. The
+compiled graph is `agent.graph.graph`. `from agent import graph` gives the
+`agent.graph` module; it still forwards graph methods such as `ainvoke` to the
+compiled graph, with a `DeprecationWarning`.
 """
 
-from agent.graph import graph
+import importlib
+from typing import Any
 
 __all__ = ["graph"]
+
+
+def __getattr__(name: str) -> Any:
+    """Import the submodules listed in `__all__` on first access."""
+    if name in __all__:
+        return importlib.import_module(f"{__name__}.{name}")
+    raise AttributeError(f"module {__name__!r} has no attribute {name!r}")
@@ -0,0 +1,162 @@
+"""Per-run token, cache and latency accounting for `call_model`.
+
+Each `call_model` turn reports a `RunUsage` record in `metadata["usage"]` and
+adds it to the thread's running total in `metadata["usage_total"]`. Records are
+also summed in the process-wide `ledger`, keyed by assistant (or
+`Context.usage_label`) and model, and reported as metrics:
+
+    agent_usage_runs{label, model, source}     one per turn
+    agent_usage_tokens{label, model, kind}     input, output, cache_read,
+                                               cache_write
+    agent_usage_seconds{label, model, phase}   queue, network, generation
+
+`source` is `"model"` for a model call, `"exact"` or `"semantic"` for a turn
+served from `agent.cache` or `agent.semantic_cache`, and `"timeout"` for a call
+abandoned at its deadline. A hedged or raced turn also records each call that
+didn't produce its output, as `"hedge_loser"` or `"race_loser"`, in
+`metadata["usage_lost"]`: their tokens count towards the totals, and they are
+counted as `lost_attempts` rather than `runs`. The latency phases of a model call are:
+
+    queue_s        waiting for a rate-limiter slot or for a micro-batch to
+                   be flushed
+    network_s      time to the first chunk when streaming; otherwise the call
+                   time not covered by the provider's reported `generation_s`
+    generation_s   the rest of the call (the whole call if the provider
+                   reports nothing)
+
+`total_s` is the wall time of the whole turn, cache lookups included.
+"""
+
+from __future__ import annotations
+
+from typing import Any, Dict, List, Mapping, Optional, Tuple
+
+from typing_extensions import TypedDict
+
+from agent import metrics
+from agent.prompts import Usage
+
+_TOKEN_KINDS = {
+    "input_tokens": "input",
+    "output_tokens": "output",
+    "cache_read_input_tokens": "cache_read",
+    "cache_creation_input_tokens": "cache_write",
+}
+_PHASES = {"queue_s": "queue", "network_s": "network", "generation_s": "generation"}
+_CACHED_SOURCES = ("exact", "semantic")
+_LOST_SOURCES = ("hedge_loser", "race_loser")
+
+
+class Latency(TypedDict, total=False):
+    """Where the time of one model call went, in seconds."""
+
+    queue_s: float
+    network_s: float
+    generation_s: float
+
+
+class RunUsage(Usage, Latency, total=False):
+    """Usage record for one `call_model` turn."""
+
+    model: str
+    source: str
+    """`"model"`, `"exact"`, `"semantic"`, `"timeout"`, or a loser's source."""
+    total_s: float
+
+
+def split_call(reported: Latency, call_s: float) -> Latency:
+    """Split a non-streaming call of `call_s` into network and generation time.
+
+    `reported` is what the backend returned; providers that expose their
+    processing time (e.g. `openai-processing-ms`) set `generation_s` there.
+    """
+    latency = reported.copy()
+    generation = reported.get("generation_s")
+    if generation is None:
+        latency["generation_s"] = call_s
+    else:
+        latency["network_s"] = max(0.0, call_s - generation)
+    return latency
+
+
+def usage_label(context: Mapping[str, Any], config: Mapping[str, Any]) -> str:
+    """Return the ledger label: `Context.usage_label`, else the assistant id."""
+    label = context.get("usage_label")
+    if label:
+        return str(label)
+    for section in ("metadata", "configurable"):
+        assistant = (config.get(section) or {}).get("assistant_id")
+        if assistant:
+            return str(assistant)
+    return "default"
+
+
+def accumulate(
+    total: Optional[Mapping[str, Any]], record: Mapping[str, Any]
+) -> Dict[str, Any]:
+    """Add `record` to a running `total`, counting runs and cached runs."""
+    out: Dict[str, Any] = dict(total or {})
+    if record.get("source") in _LOST_SOURCES:
+        out["lost_attempts"] = out.get("lost_attempts", 0) + 1
+    else:
+        out["runs"] = out.get("runs", 0) + 1
+    if record.get("source") in _CACHED_SOURCES:
+        out["cached_runs"] = out.get("cached_runs", 0) + 1
+    for key in (*_TOKEN_KINDS, *_PHASES, "total_s"):
+        if record.get(key):
+            out[key] = out.get(key, 0) + record[key]
+    return out
+
+
+class UsageLedger:
+    """Usage totals per (label, model) for this process."""
+
+    def __init__(self) -> None:
+        """Start with no recorded runs."""
+        self._totals: Dict[Tuple[str, str], Dict[str, Any]] = {}
+
+    def record(self, label: str, usage: RunUsage) -> None:
+        """Add one turn's usage under `label` and report it as metrics."""
+        model = usage.get("model", "default")
+        key = (label, model)
+        self._totals[key] = accumulate(self._totals.get(key), usage)
+        values: Mapping[str, Any] = usage
+        metrics.increment(
+            "agent_usage_runs",
+            label=label,
+            model=model,
+            source=usage.get("source", "model"),
+        )
+        for field, kind in _TOKEN_KINDS.items():
+            if values.get(field):
+                metrics.increment(
+                    "agent_usage_tokens",
+                    values[field],
+                    label=label,
+                    model=model,
+                    kind=kind,
+                )
+        for field, phase in _PHASES.items():
+            if field in values:
+                metrics.observe(
+                    "agent_usage_seconds",
+                    values[field],
+                    label=label,
+                    model=model,
+                    phase=phase,
+                )
+
+    def snapshot(self) -> List[Dict[str, Any]]:
+        """Return the totals as JSON-ready rows, one per (label, model)."""
+        return [
+            {"label": label, "model": model, **total}
+            for (label, model), total in sorted(self._totals.items())
+        ]
+
+    def reset(self) -> None:
+        """Forget all totals."""
+        self._totals.clear()
+
+
+ledger = UsageLedger()
+"""Process-wide totals, served on `GET /usage` by `agent.webapp`."""
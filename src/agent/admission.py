@@ -0,0 +1,371 @@
+"""Admission control: keep latency bounded for the runs a worker accepts.
+
+Without a cap, a spike is accepted in full and every run slows down together.
+`guard` wraps the `agent` graph's `call_model` node and rejects work early,
+before any model tokens are spent:
+
+- At most `AGENT_MAX_INFLIGHT_RUNS` guarded runs execute at once per worker
+  process. Further runs wait in FIFO order, at most `AGENT_ADMISSION_MAX_QUEUE`
+  of them (default: as many as may run). A run that finds the queue full is
+  shed at once; one that waits longer than `AGENT_ADMISSION_MAX_QUEUE_MS`
+  (default 1000) is shed when its time runs out, and for that long after, new
+  runs are shed at once unless a slot is free or the queue drains.
+- `Context.max_concurrent_runs` caps the runs of one assistant (or
+  `Context.usage_label`) in this process; runs over the cap are shed at once.
+- `Context.max_state_bytes` (default `AGENT_MAX_STATE_BYTES`) rejects a run
+  whose `State` encodes to more bytes than that, and `Context.max_turns`
+  rejects one whose thread already has that many turns.
+
+A rejected run ends with `metadata["outcome"] == "rejected"` and a `reason`,
+like a timed-out one.
+
+`AdmissionMiddleware` (installed by `webapp.py` when any of the settings above
+is set) answers run-creating requests before they reach the server's queue.
+It returns 429 while the wait queue is full and 503 while queued runs wait out
+the whole limit, both with `Retry-After`. It returns 413 for a body
+larger than `AGENT_ADMISSION_MAX_BODY_BYTES`, whether declared in
+`Content-Length` or found while reading a chunked one (which it buffers, up to
+the limit, before the server sees it), and 400 for a `Content-Length` that
+isn't a number. Rejections are counted in
+`agent_admission_rejected{reason}`, and time spent waiting is reported as
+`agent_admission_queue_seconds`.
+"""
+
+from __future__ import annotations
+
+import asyncio
+import dataclasses
+import functools
+import json
+import math
+import os
+import re
+import time
+from collections import deque
+from contextlib import asynccontextmanager, contextmanager
+from typing import (
+    Any,
+    AsyncIterator,
+    Awaitable,
+    Callable,
+    Deque,
+    Dict,
+    Iterator,
+    List,
+    Mapping,
+    Optional,
+    Tuple,
+)
+
+from langgraph.config import get_config
+
+from agent import metrics
+from agent.accounting import usage_label
+
+
+class Overloaded(Exception):
+    """Raised when a run is not admitted."""
+
+    def __init__(self, status: int, reason: str, retry_after: float = 1.0) -> None:
+        """Record the HTTP `status` to answer with and why."""
+        super().__init__(reason)
+        self.status = status
+        self.reason = reason
+        self.retry_after = retry_after
+
+
+class AdmissionController:
+    """Cap in-flight runs, with a bounded FIFO queue that sheds on wait time."""
+
+    def __init__(
+        self,
+        max_inflight: int,
+        *,
+        max_queue: Optional[int] = None,
+        max_queue_s: float = 1.0,
+    ) -> None:
+        """Admit `max_inflight` runs at once (0: unlimited)."""
+        self.max_inflight = max_inflight
+        self.max_queue = max_inflight if max_queue is None else max_queue
+        self.max_queue_s = max_queue_s
+        self.inflight = 0
+        self.queue_delay = 0.0
+        """How long the last run to leave the queue spent in it."""
+        self._delay_at = 0.0
+        self._waiters: Deque[Tuple[float, asyncio.Future[None]]] = deque()
+
+    @property
+    def waiting(self) -> int:
+        """Number of runs waiting for a slot."""
+        return len(self._waiters)
+
+    def overloaded(self) -> Optional[Overloaded]:
+        """Return the rejection a new run would get right now, if any."""
+        if not self.max_inflight or self.inflight < self.max_inflight:
+            return None
+        retry_after = max(1.0, math.ceil(self.max_queue_s))
+        if len(self._waiters) >= self.max_queue:
+            return Overloaded(429, "queue_full", retry_after)
+        # Like CoDel: if runs are leaving the queue only at the deadline, a new
+        # one would wait just as long; refuse it now rather than later.
+        # The signal expires after one wait limit, so one run may probe again.
+        if (
+            self.queue_delay >= self.max_queue_s
+            and time.monotonic() - self._delay_at < self.max_queue_s
+        ):
+            return Overloaded(503, "queue_time", retry_after)
+        return None
+
+    async def _acquire(self) -> None:
+        if self.inflight < self.max_inflight and not self._waiters:
+            self.inflight += 1
+            self.queue_delay = 0.0
+            return
+        error = self.overloaded()
+        if error is not None:
+            raise error
+        entry = (time.monotonic(), asyncio.get_running_loop().create_future())
+        self._waiters.append(entry)
+        future = entry[1]
+        try:
+            await asyncio.wait({future}, timeout=self.max_queue_s)
+        except BaseException:
+            # Cancelled while waiting; give back a slot handed over meanwhile.
+            if future.done():
+                self._release()
+            else:
+                future.cancel()
+                self._waiters.remove(entry)
+            raise
+        self._delay_at = time.monotonic()
+        self.queue_delay = self._delay_at - entry[0]
+        metrics.observe("agent_admission_queue_seconds", self.queue_delay)
+        if not future.done():
+            future.cancel()
+            self._waiters.remove(entry)
+            raise Overloaded(503, "queue_time", max(1.0, math.ceil(self.max_queue_s)))
+
+    def _release(self) -> None:
+        # Hand the slot straight to the next waiter, so it can't be overtaken.
+        while self._waiters:
+            _, future = self._waiters.popleft()
+            if not future.done():
+                future.set_result(None)
+                return
+        # Nobody is waiting any more, so there is no queue delay either.
+        self.queue_delay = 0.0
+        self.inflight -= 1
+
+    @asynccontextmanager
+    async def admit(self) -> AsyncIterator[None]:
+        """Hold a slot for the duration of the block; raise `Overloaded` if shed."""
+        if not self.max_inflight:
+            yield
+            return
+        await self._acquire()
+        try:
+            yield
+        finally:
+            self._release()
+
+
+class Quotas:
+    """Concurrent runs per label, each capped by its own limit."""
+
+    def __init__(self) -> None:
+        """Start with no runs."""
+        self.running: Dict[str, int] = {}
+
+    @contextmanager
+    def hold(self, label: str, limit: Optional[int]) -> Iterator[None]:
+        """Count one run under `label`; raise `Overloaded` if at `limit`."""
+        if not limit:
+            yield
+            return
+        if self.running.get(label, 0) >= limit:
+            raise Overloaded(429, "quota")
+        self.running[label] = self.running.get(label, 0) + 1
+        try:
+            yield
+        finally:
+            self.running[label] -= 1
+
+
+def state_bytes(state: Any) -> int:
+    """Size of `state` as compact JSON, the budget `max_state_bytes` applies to."""
+    if dataclasses.is_dataclass(state) and not isinstance(state, type):
+        state = dataclasses.asdict(state)
+    return len(json.dumps(state, separators=(",", ":"), default=str))
+
+
+_env = os.environ
+controller = AdmissionController(
+    int(_env.get("AGENT_MAX_INFLIGHT_RUNS", 0)),
+    max_queue=(
+        int(_env["AGENT_ADMISSION_MAX_QUEUE"])
+        if _env.get("AGENT_ADMISSION_MAX_QUEUE")
+        else None
+    ),
+    max_queue_s=float(_env.get("AGENT_ADMISSION_MAX_QUEUE_MS", 1000)) / 1000,
+)
+"""Per-process in-flight cap shared by every guarded run."""
+
+quotas = Quotas()
+"""Per-process concurrency per assistant, from `Context.max_concurrent_runs`."""
+
+_default_max_state_bytes = int(_env.get("AGENT_MAX_STATE_BYTES", 0))
+
+
+def _rejected(reason: str) -> Dict[str, Any]:
+    metrics.increment("agent_admission_rejected", reason=reason)
+    # `errors` too, so a rejection never shows an earlier turn's.
+    return {"metadata": {"outcome": "rejected", "reason": reason, "errors": None}}
+
+
+def guard(
+    node: Callable[[Any, Any], Awaitable[Dict[str, Any]]],
+) -> Callable[[Any, Any], Awaitable[Dict[str, Any]]]:
+    """Wrap a `(state, runtime)` node with the checks described above.
+
+    Keeps the node's name and signature, like `metrics.instrument`.
+    """
+
+    @functools.wraps(node)
+    async def wrapper(state: Any, runtime: Any) -> Dict[str, Any]:
+        context: Mapping[str, Any] = runtime.context or {}
+        max_turns = context.get("max_turns")
+        if max_turns and getattr(state, "turns", 0) >= max_turns:
+            return _rejected("max_turns")
+        max_bytes = context.get("max_state_bytes", _default_max_state_bytes)
+        if max_bytes and state_bytes(state) > max_bytes:
+            return _rejected("state_bytes")
+        label = usage_label(context, get_config())
+        try:
+            with quotas.hold(label, context.get("max_concurrent_runs")):
+                async with controller.admit():
+                    return await node(state, runtime)
+        except Overloaded as exc:
+            return _rejected(exc.reason)
+
+    return wrapper
+
+
+# POST /runs, /runs/wait, /runs/stream, /runs/batch, with or without a thread.
+_RUN_PATH = re.compile(r"^/(threads/[^/]+/)?runs(/wait|/stream|/batch)?/?$")
+
+
+class AdmissionMiddleware:
+    """ASGI middleware that refuses run-creating requests under overload."""
+
+    def __init__(self, app: Any, *, max_body_bytes: Optional[int] = None) -> None:
+        """Wrap `app`; `max_body_bytes` defaults to the env setting."""
+        self.app = app
+        if max_body_bytes is None:
+            max_body_bytes = int(_env.get("AGENT_ADMISSION_MAX_BODY_BYTES", 0))
+        self.max_body_bytes = max_body_bytes
+
+    async def __call__(self, scope: Any, receive: Any, send: Any) -> None:
+        """Answer 413/429/503 for run-creating requests; pass the rest through."""
+        if (
+            scope["type"] != "http"
+            or scope["method"] != "POST"
+            or not _RUN_PATH.match(scope["path"])
+        ):
+            await self.app(scope, receive, send)
+            return
+        if self.max_body_bytes:
+            headers = dict(scope.get("headers") or [])
+            length = headers.get(b"content-length")
+            if length is not None and not length.isdigit():
+                metrics.increment(
+                    "agent_admission_rejected", reason="bad_content_length"
+                )
+                await _respond(send, 400, "bad_content_length")
+                return
+            if length is not None and int(length) > self.max_body_bytes:
+                metrics.increment("agent_admission_rejected", reason="body_bytes")
+                await _respond(send, 413, "body_bytes")
+                return
+        error = controller.overloaded()
+        if error is not None:
+            metrics.increment("agent_admission_rejected", reason=error.reason)
+            await _respond(send, error.status, error.reason, error.retry_after)
+            return
+        if self.max_body_bytes:
+            try:
+                body = await _read_body(receive, self.max_body_bytes)
+            except _Disconnected:
+                return
+            if body is None:
+                metrics.increment("agent_admission_rejected", reason="body_bytes")
+                await _respond(send, 413, "body_bytes")
+                return
+            receive = _replay(body, receive)
+        await self.app(scope, receive, send)
+
+
+class _Disconnected(Exception):
+    """The client went away before sending its whole body."""
+
+
+async def _read_body(receive: Any, limit: int) -> Optional[bytes]:
+    """Read the request body; None once it exceeds `limit` bytes.
+
+    Counts what actually arrives, so a chunked body or a short
+    `Content-Length` can't get past the limit.
+    """
+    chunks: List[bytes] = []
+    size = 0
+    while True:
+        message = await receive()
+        if message["type"] != "http.request":
+            raise _Disconnected
+        chunk = message.get("body", b"")
+        size += len(chunk)
+        if size > limit:
+            return None
+        chunks.append(chunk)
+        if not message.get("more_body", False):
+            break
+    return b"".join(chunks)
+
+
+def _replay(body: bytes, receive: Any) -> Any:
+    """Return a `receive` that yields `body` once, then defers to `receive`."""
+    pending = True
+
+    async def replay() -> Dict[str, Any]:
+        nonlocal pending
+        if pending:
+            pending = False
+            return {"type": "http.request", "body": body, "more_body": False}
+        message: Dict[str, Any] = await receive()
+        return message
+
+    return replay
+
+
+async def _respond(
+    send: Any, status: int, reason: str, retry_after: Optional[float] = None
+) -> None:
+    body = json.dumps({"detail": reason}).encode()
+    headers = [
+        (b"content-type", b"application/json"),
+        (b"content-length", str(len(body)).encode()),
+    ]
+    if retry_after is not None:
+        headers.append((b"retry-after", str(int(retry_after)).encode()))
+    await send({"type": "http.response.start", "status": status, "headers": headers})
+    await send({"type": "http.response.body", "body": body})
+
+
+def enabled() -> bool:
+    """Return whether any admission setting is configured in the environment."""
+    return any(
+        _env.get(name)
+        for name in (
+            "AGENT_MAX_INFLIGHT_RUNS",
+            "AGENT_MAX_STATE_BYTES",
+            "AGENT_ADMISSION_MAX_BODY_BYTES",
+        )
+    )
@@ -0,0 +1,147 @@
+"""Bulk runs over a JSONL file, for offline scoring and evaluation.
+
+    python -m agent.batch input.jsonl -o output.jsonl --concurrency 64
+
+Each input line is one graph input. Output line N holds the result for input
+line N, as `{"index": N, "output": ...}` or `{"index": N, "error": ...}`, and
+is flushed as soon as every earlier line is written. Because output order
+matches input order, the output file doubles as the progress marker:
+rerunning the same command after a crash skips the lines already written
+(dropping a torn last line) and carries on.
+
+Inputs are read lazily and results written as they complete. At most
+`concurrency` runs are in flight, and at most `window` finished results wait
+behind a slow one, so memory stays flat however large the input is. Runs use
+`durability="exit"` and, when a checkpointer is configured, one thread per
+line (`batch-<batch id>-<N>`). The batch id is random unless `--batch-id`
+gives one, so separate batches never resume each other's threads; pass the
+same id to a rerun to keep its threads too.
+"""
+
+from __future__ import annotations
+
+import argparse
+import asyncio
+import importlib
+import json
+import os
+import sys
+import uuid
+from collections import deque
+from typing import IO, Any, Deque, Dict, Mapping, Optional
+
+from agent import resources
+
+
+def completed_lines(path: str) -> int:
+    """Count complete lines in `path`, truncating a partial trailing line."""
+    if not os.path.exists(path):
+        return 0
+    count = 0
+    good = 0
+    with open(path, "rb+") as f:
+        for line in f:
+            if not line.endswith(b"\n"):
+                break
+            count += 1
+            good += len(line)
+        f.truncate(good)
+    return count
+
+
+async def _run_one(
+    graph: Any,
+    batch_id: str,
+    index: int,
+    line: str,
+    context: Mapping[str, Any],
+    slots: asyncio.Semaphore,
+) -> Dict[str, Any]:
+    async with slots:
+        try:
+            config: Dict[str, Any] = {}
+            if getattr(graph, "checkpointer", None) is not None:
+                config = {"configurable": {"thread_id": f"batch-{batch_id}-{index}"}}
+            output = await graph.ainvoke(
+                json.loads(line), config, context=context, durability="exit"
+            )
+            return {"index": index, "output": output}
+        except Exception as exc:
+            return {"index": index, "error": repr(exc)}
+
+
+def _write(out: IO[str], record: Dict[str, Any]) -> None:
+    out.write(json.dumps(record, default=str) + "\n")
+    out.flush()
+
+
+async def run_batch(
+    graph: Any,
+    input_path: str,
+    output_path: str,
+    *,
+    context: Optional[Mapping[str, Any]] = None,
+    concurrency: int = 64,
+    window: Optional[int] = None,
+    batch_id: Optional[str] = None,
+) -> int:
+    """Run `graph` over every line of `input_path`; return lines processed now.
+
+    Resumes after the lines already in `output_path`. `batch_id` names the
+    runs' threads (default: a random id).
+    """
+    batch_id = batch_id or uuid.uuid4().hex
+    skip = completed_lines(output_path)
+    slots = asyncio.Semaphore(concurrency)
+    pending: Deque[asyncio.Task[Dict[str, Any]]] = deque()
+    limit = window or concurrency * 4
+    done = 0
+    with open(input_path) as inp, open(output_path, "a") as out:
+        for index, line in enumerate(inp):
+            if index < skip:
+                continue
+            if len(pending) >= limit:
+                _write(out, await pending.popleft())
+                done += 1
+            coro = _run_one(graph, batch_id, index, line, context or {}, slots)
+            pending.append(asyncio.create_task(coro))
+            # Write whatever is already finished at the head, in order.
+            while pending and pending[0].done():
+                _write(out, pending.popleft().result())
+                done += 1
+        while pending:
+            _write(out, await pending.popleft())
+            done += 1
+    return done
+
+
+async def _main(args: argparse.Namespace) -> int:
+    graph_module = importlib.import_module("agent.graph")
+    graph = getattr(graph_module, args.graph)
+    output = args.output or f"{os.path.splitext(args.input)[0]}.out.jsonl"
+    await resources.startup()
+    try:
+        return await run_batch(
+            graph,
+            args.input,
+            output,
+            context=json.loads(args.context),
+            concurrency=args.concurrency,
+            batch_id=args.batch_id,
+        )
+    finally:
+        await resources.shutdown()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="JSONL file, one graph input per line")
+    parser.add_argument("-o", "--output", help="default: <input>.out.jsonl")
+    parser.add_argument("--concurrency", type=int, default=64)
+    parser.add_argument("--context", default="{}", help="JSON Context for all runs")
+    parser.add_argument("--batch-id", help="thread id prefix; default: random")
+    parser.add_argument(
+        "--graph", default="graph", choices=["graph", "fanout_graph"]
+    )
+    count = asyncio.run(_main(parser.parse_args()))
+    sys.stderr.write(f"processed {count} lines\n")
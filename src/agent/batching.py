@@ -0,0 +1,88 @@
+"""Micro-batching for node-level backend calls.
+
+Concurrent callers that arrive within a short window are coalesced into a
+single call of a batch-capable function and receive their own result back.
+"""
+
+from __future__ import annotations
+
+import asyncio
+from typing import (
+    Awaitable,
+    Callable,
+    Generic,
+    List,
+    Optional,
+    Sequence,
+    Set,
+    Tuple,
+    TypeVar,
+)
+
+T = TypeVar("T")
+R = TypeVar("R")
+
+BatchFn = Callable[[Sequence[T]], Awaitable[Sequence[R]]]
+
+
+class MicroBatcher(Generic[T, R]):
+    """Coalesce concurrent `submit` calls into batched calls of `fn`.
+
+    A batch is flushed when it reaches `max_batch_size` items or when
+    `window` seconds have passed since its first item arrived, whichever
+    comes first. `fn` must return exactly one result per input, in order.
+    """
+
+    def __init__(
+        self, fn: BatchFn[T, R], *, window: float, max_batch_size: int
+    ) -> None:
+        """Create a batcher around `fn`."""
+        if max_batch_size < 1:
+            raise ValueError("max_batch_size must be >= 1")
+        self._fn = fn
+        self.window = window
+        self.max_batch_size = max_batch_size
+        self._pending: List[Tuple[T, asyncio.Future[R]]] = []
+        self._timer: Optional[asyncio.TimerHandle] = None
+        self._inflight: Set[asyncio.Task[None]] = set()
+
+    async def submit(self, item: T) -> R:
+        """Queue `item` for the next batch and wait for its result."""
+        loop = asyncio.get_running_loop()
+        future: asyncio.Future[R] = loop.create_future()
+        self._pending.append((item, future))
+        if len(self._pending) >= self.max_batch_size:
+            self._flush()
+        elif self._timer is None:
+            self._timer = loop.call_later(self.window, self._flush)
+        return await future
+
+    def _flush(self) -> None:
+        if self._timer is not None:
+            self._timer.cancel()
+            self._timer = None
+        batch, self._pending = self._pending, []
+        if not batch:
+            return
+        task = asyncio.ensure_future(self._run(batch))
+        # Hold a reference so the task isn't garbage collected mid-flight.
+        self._inflight.add(task)
+        task.add_done_callback(self._inflight.discard)
+
+    async def _run(self, batch: List[Tuple[T, asyncio.Future[R]]]) -> None:
+        try:
+            results = await self._fn([item for item, _ in batch])
+            if len(results) != len(batch):
+                raise RuntimeError(
+                    f"batch function returned {len(results)} results "
+                    f"for {len(batch)} inputs"
+                )
+        except Exception as exc:
+            for _, future in batch:
+                if not future.done():
+                    future.set_exception(exc)
+            return
+        for (_, future), result in zip(batch, results):
+            # Callers that were cancelled while waiting are simply skipped.
+            if not future.done():
+                future.set_result(result)
@@ -0,0 +1,329 @@
+"""Content-addressed blob storage for large `State` payloads.
+
+A large document or image put in `State` is copied into every checkpoint,
+stream event and trace. Store it once instead and keep only a `BlobRef` in
+state: a short string `blob:sha256:<hex>:<size>`, so it survives any
+serializer, JSON stream or trace viewer unchanged. Nodes that need the bytes
+resolve the reference themselves; nodes that don't never pay for it.
+
+    ref = await blob_store.put(pdf_bytes)          # or POST /blobs
+    data = await blob_store.get(ref)               # memoryview; mmap-backed locally
+    ...
+    release(data)                                  # closes the mapping
+
+Configured with `AGENT_BLOB_STORE`:
+
+    file:///var/lib/agent/blobs   local directory (default `blobs` under
+                                  `AGENT_DATA_DIR`), read through mmap
+    s3://bucket/prefix            S3 or compatible (needs `boto3`), for
+                                  deployments with more than one replica
+
+`AGENT_DATA_DIR` defaults to `$XDG_DATA_HOME/agent` (`~/.local/share/agent`),
+so the store doesn't move with the server's working directory.
+
+Identical payloads share one object, and writes are idempotent. References
+are validated (`blob:sha256:<64 lowercase hex>:<size>`) before a store turns
+them into a path or key, so a crafted reference can't name other files.
+
+Local blobs not written or read for `AGENT_BLOB_TTL_S` seconds (default 30
+days; 0 keeps them forever) are deleted by a sweep the server runs in the
+background; see `install`. A thread whose state still references a swept blob
+gets `KeyError` on resolving it, so set the TTL above the longest-lived
+thread's idle time. For S3, expire the prefix with a bucket lifecycle rule.
+"""
+
+from __future__ import annotations
+
+import asyncio
+import hashlib
+import importlib
+import logging
+import mmap
+import os
+import re
+import tempfile
+import time
+from typing import Any, Optional, Union
+
+from typing_extensions import Protocol
+
+from agent import resources
+from agent.offload import run_cpu
+
+logger = logging.getLogger(__name__)
+
+PREFIX = "blob:sha256:"
+
+_DIGEST = re.compile(r"[0-9a-f]{64}")
+_REF = re.compile(r"blob:sha256:[0-9a-f]{64}:[0-9]+")
+
+# Hashing beyond this size moves to the CPU executor.
+_OFFLOAD_BYTES = 1 << 20
+
+DEFAULT_TTL_S = 30 * 24 * 3600.0
+
+
+class BlobRef(str):
+    """Reference to a stored blob; a plain `str` on the wire."""
+
+    @classmethod
+    def for_digest(cls, digest: str, size: int) -> BlobRef:
+        """Build the reference for a payload's sha256 hex digest and size."""
+        return cls(f"{PREFIX}{check_digest(digest)}:{size}")
+
+    @property
+    def digest(self) -> str:
+        """The payload's sha256 hex digest; raise `ValueError` if malformed."""
+        return check_digest(self[len(PREFIX) :].rpartition(":")[0])
+
+    @property
+    def size(self) -> int:
+        """The payload's length in bytes."""
+        return int(self.rpartition(":")[2])
+
+
+def check_digest(digest: str) -> str:
+    """Return `digest` if it is a sha256 hex digest; raise `ValueError` if not."""
+    if not _DIGEST.fullmatch(digest):
+        raise ValueError(f"invalid blob digest: {digest!r}")
+    return digest
+
+
+def is_blob_ref(value: Any) -> bool:
+    """Return whether `value` is a well-formed blob reference.
+
+    True even after a round trip through JSON, where it arrives as a `str`.
+    """
+    return isinstance(value, str) and _REF.fullmatch(value) is not None
+
+
+def release(data: memoryview) -> None:
+    """Release `data` from `BlobStore.get`, closing its mmap if it has one."""
+    backing = data.obj
+    data.release()
+    if isinstance(backing, mmap.mmap):
+        backing.close()
+
+
+class BlobStore(Protocol):
+    """Interface implemented by blob backends."""
+
+    async def put(self, data: bytes) -> BlobRef:
+        """Store `data` (if not already stored) and return its reference."""
+        ...
+
+    async def get(self, ref: str) -> memoryview:
+        """Return the bytes behind `ref`; raise `KeyError` if missing.
+
+        Raise `ValueError` if `ref` is malformed. Pass the result to `release`
+        once done with it.
+        """
+        ...
+
+
+async def _digest(data: bytes) -> str:
+    if len(data) > _OFFLOAD_BYTES:
+        return await run_cpu(lambda: hashlib.sha256(data).hexdigest())
+    return hashlib.sha256(data).hexdigest()
+
+
+class LocalBlobStore:
+    """Blobs as files named by digest under a directory, read via mmap."""
+
+    def __init__(self, root: str) -> None:
+        """Store blobs under `root`, created on the first write."""
+        # Absolute, so a later chdir doesn't move the store.
+        self.root = os.path.abspath(root)
+
+    def _path(self, digest: str) -> str:
+        return os.path.join(self.root, digest[:2], digest)
+
+    def _write(self, digest: str, data: bytes) -> None:
+        path = self._path(digest)
+        if _touch(path):
+            return
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        # Write-then-rename, so readers never see a partial blob.
+        fd, tmp = tempfile.mkstemp(dir=os.path.dirname(path))
+        with os.fdopen(fd, "wb") as f:
+            f.write(data)
+        os.replace(tmp, path)
+
+    async def put(self, data: bytes) -> BlobRef:
+        """Store `data` and return its reference."""
+        digest = await _digest(data)
+        await asyncio.to_thread(self._write, digest, data)
+        return BlobRef.for_digest(digest, len(data))
+
+    async def get(self, ref: str) -> memoryview:
+        """Map the blob read-only; pages are loaded only as they're touched."""
+        path = self._path(check_digest(BlobRef(ref).digest))
+        try:
+            with open(path, "rb") as f:
+                _touch(path)
+                if os.fstat(f.fileno()).st_size == 0:
+                    return memoryview(b"")
+                return memoryview(mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ))
+        except FileNotFoundError:
+            raise KeyError(ref) from None
+
+    def sweep(self, max_age_s: float) -> int:
+        """Delete blobs not written or read for `max_age_s`; return how many.
+
+        Left-over temporary files from interrupted writes go the same way.
+        """
+        cutoff = time.time() - max_age_s
+        removed = 0
+        try:
+            shards = os.scandir(self.root)
+        except FileNotFoundError:
+            return 0
+        with shards:
+            for shard in shards:
+                if not shard.is_dir(follow_symlinks=False):
+                    continue
+                with os.scandir(shard.path) as entries:
+                    for entry in entries:
+                        try:
+                            if entry.stat(follow_symlinks=False).st_mtime < cutoff:
+                                os.unlink(entry.path)
+                                removed += 1
+                        except FileNotFoundError:
+                            pass
+        return removed
+
+
+def _touch(path: str) -> bool:
+    """Mark `path` as used now; return False if it doesn't exist."""
+    try:
+        os.utime(path)
+    except FileNotFoundError:
+        return False
+    return True
+
+
+class S3BlobStore:
+    """Blobs as objects named by digest in an S3 bucket."""
+
+    def __init__(self, bucket: str, prefix: str = "", client: Any = None) -> None:
+        """Use `bucket`/`prefix`, with a boto3 client from the environment."""
+        self.bucket = bucket
+        self.prefix = prefix.strip("/")
+        self._client = client or importlib.import_module("boto3").client("s3")
+
+    def _key(self, digest: str) -> str:
+        return f"{self.prefix}/{digest}" if self.prefix else digest
+
+    async def put(self, data: bytes) -> BlobRef:
+        """Upload `data` and return its reference."""
+        digest = await _digest(data)
+        await asyncio.to_thread(
+            self._client.put_object,
+            Bucket=self.bucket,
+            Key=self._key(digest),
+            Body=data,
+        )
+        return BlobRef.for_digest(digest, len(data))
+
+    async def get(self, ref: str) -> memoryview:
+        """Download the blob behind `ref`."""
+        key = self._key(check_digest(BlobRef(ref).digest))
+
+        def fetch() -> bytes:
+            try:
+                response = self._client.get_object(Bucket=self.bucket, Key=key)
+            except self._client.exceptions.NoSuchKey:
+                raise KeyError(ref) from None
+            body: bytes = response["Body"].read()
+            return body
+
+        return memoryview(await asyncio.to_thread(fetch))
+
+
+def data_dir() -> str:
+    """Return `AGENT_DATA_DIR`, or the user's XDG data directory for the agent."""
+    configured = os.environ.get("AGENT_DATA_DIR")
+    if configured:
+        return os.path.abspath(configured)
+    base = os.environ.get("XDG_DATA_HOME") or os.path.expanduser("~/.local/share")
+    return os.path.join(base, "agent")
+
+
+def make_blob_store(uri: Optional[str]) -> Union[LocalBlobStore, S3BlobStore]:
+    """Build the blob store described by `uri` (default: `data_dir()/blobs`)."""
+    if not uri:
+        return LocalBlobStore(os.path.join(data_dir(), "blobs"))
+    if uri.startswith("file://"):
+        return LocalBlobStore(uri.removeprefix("file://"))
+    if uri.startswith("s3://"):
+        bucket, _, prefix = uri.removeprefix("s3://").partition("/")
+        return S3BlobStore(bucket, prefix)
+    raise ValueError(f"Unsupported AGENT_BLOB_STORE: {uri!r}")
+
+
+blob_store: BlobStore = make_blob_store(os.environ.get("AGENT_BLOB_STORE"))
+"""Process-wide store used by nodes and `POST /blobs`."""
+
+
+async def resolve_text(value: str, store: Optional[BlobStore] = None) -> str:
+    """Return `value`, or the UTF-8 text behind it if it is a blob reference.
+
+    A blob that isn't UTF-8 text (an image, say) is left as its reference, for
+    nodes that read the bytes themselves.
+    """
+    if not is_blob_ref(value):
+        return value
+    data = await (store or blob_store).get(value)
+    try:
+        return str(data, "utf-8")
+    except UnicodeDecodeError:
+        logger.warning("Blob %s is not UTF-8 text; leaving the reference", value)
+        return value
+    finally:
+        release(data)
+
+
+class BlobSweeper:
+    """Periodically delete local blobs older than a TTL."""
+
+    def __init__(self, store: LocalBlobStore, ttl_s: float) -> None:
+        """Sweep `store` for blobs unused for `ttl_s`, hourly or more often."""
+        self.store = store
+        self.ttl_s = ttl_s
+        self.interval = min(ttl_s / 4, 3600.0)
+        self._task: Optional[asyncio.Task[None]] = None
+
+    async def _sweep_forever(self) -> None:
+        while True:
+            try:
+                removed = await asyncio.to_thread(self.store.sweep, self.ttl_s)
+            except OSError:
+                logger.exception("Blob sweep of %s failed", self.store.root)
+            else:
+                if removed:
+                    logger.info("Swept %d blobs from %s", removed, self.store.root)
+            await asyncio.sleep(self.interval)
+
+    async def start(self) -> None:
+        """Start sweeping in the background."""
+        self._task = asyncio.create_task(self._sweep_forever())
+
+    async def stop(self) -> None:
+        """Stop sweeping."""
+        if self._task is not None:
+            self._task.cancel()
+            await asyncio.gather(self._task, return_exceptions=True)
+
+
+def install() -> Optional[BlobSweeper]:
+    """Sweep the local `blob_store` while the server runs, per `AGENT_BLOB_TTL_S`.
+
+    Returns the sweeper, or None for S3 (use a lifecycle rule) or a zero TTL.
+    """
+    ttl_s = float(os.environ.get("AGENT_BLOB_TTL_S", DEFAULT_TTL_S))
+    if not isinstance(blob_store, LocalBlobStore) or ttl_s <= 0:
+        return None
+    sweeper = BlobSweeper(blob_store, ttl_s)
+    resources.on_startup(sweeper.start)
+    resources.on_shutdown(sweeper.stop)
+    return sweeper
@@ -0,0 +1,222 @@
+"""Node-level response caching.
+
+`call_model` results are keyed on a stable hash of the `State` fields and the
+`Context` values, and stored in a pluggable backend: an in-process LRU bounded
+by bytes, or a shared Redis instance.
+"""
+
+from __future__ import annotations
+
+import dataclasses
+import hashlib
+import importlib
+import json
+import time
+from collections import OrderedDict
+from typing import Any, Callable, Dict, Iterable, List, Mapping, Optional, Tuple
+
+from typing_extensions import Protocol
+
+
+def cache_key(
+    state: Any, context: Mapping[str, Any], *, ignore: Iterable[str] = ()
+) -> str:
+    """Return a stable hash of a `State` dataclass and a `Context` mapping.
+
+    Context keys listed in `ignore` (e.g. tuning knobs that don't change the
+    output) are left out of the key.
+    """
+    skip = set(ignore)
+    payload = {
+        "state": dataclasses.asdict(state),
+        "context": {k: v for k, v in context.items() if k not in skip},
+    }
+    return _digest(payload)
+
+
+def context_key(context: Mapping[str, Any], *, ignore: Iterable[str] = ()) -> str:
+    """Return a stable hash of the `Context` values not listed in `ignore`."""
+    skip = set(ignore)
+    return _digest({k: v for k, v in context.items() if k not in skip})
+
+
+def _digest(payload: Any) -> str:
+    encoded = json.dumps(payload, sort_keys=True, separators=(",", ":"), default=str)
+    return hashlib.sha256(encoded.encode()).hexdigest()
+
+
+@dataclasses.dataclass
+class CacheStats:
+    """Hit/miss counters for a cache backend."""
+
+    hits: int = 0
+    misses: int = 0
+    evictions: int = 0
+
+    @property
+    def hit_rate(self) -> float:
+        """Fraction of lookups served from the cache."""
+        total = self.hits + self.misses
+        return self.hits / total if total else 0.0
+
+
+InvalidationHook = Callable[[Optional[str]], None]
+"""Called with the invalidated key, or None when the whole cache is cleared."""
+
+
+class ResponseCache(Protocol):
+    """Interface implemented by cache backends."""
+
+    stats: CacheStats
+
+    async def get(self, key: str) -> Optional[Dict[str, Any]]:
+        """Return the cached value for `key`, or None on a miss."""
+        ...
+
+    async def set(
+        self, key: str, value: Dict[str, Any], ttl: Optional[float] = None
+    ) -> None:
+        """Store `value` under `key`, expiring after `ttl` seconds if given."""
+        ...
+
+    async def invalidate(self, key: str) -> None:
+        """Drop `key` from the cache."""
+        ...
+
+    async def clear(self) -> None:
+        """Drop every entry."""
+        ...
+
+    def on_invalidate(self, hook: InvalidationHook) -> None:
+        """Register a hook run whenever entries are invalidated."""
+        ...
+
+
+class _HookMixin:
+    def __init__(self) -> None:
+        self.stats = CacheStats()
+        self._hooks: List[InvalidationHook] = []
+
+    def on_invalidate(self, hook: InvalidationHook) -> None:
+        self._hooks.append(hook)
+
+    def _fire(self, key: Optional[str]) -> None:
+        for hook in self._hooks:
+            hook(key)
+
+
+class LRUCache(_HookMixin):
+    """In-process LRU cache bounded by the total size of stored values.
+
+    Values are stored JSON-encoded, so readers always get a fresh copy and the
+    byte budget reflects what is actually held.
+    """
+
+    def __init__(self, max_bytes: int = 64 * 1024 * 1024) -> None:
+        """Create a cache holding at most `max_bytes` of encoded values."""
+        super().__init__()
+        self.max_bytes = max_bytes
+        self.size_bytes = 0
+        # key -> (encoded value, expiry as a monotonic timestamp or None)
+        self._entries: OrderedDict[str, Tuple[bytes, Optional[float]]] = (
+            OrderedDict()
+        )
+
+    def __len__(self) -> int:
+        """Return the number of live entries."""
+        return len(self._entries)
+
+    async def get(self, key: str) -> Optional[Dict[str, Any]]:
+        """Return the cached value for `key`, or None on a miss."""
+        entry = self._entries.get(key)
+        if entry is not None and entry[1] is not None:
+            if entry[1] <= time.monotonic():
+                self._remove(key)
+                entry = None
+        if entry is None:
+            self.stats.misses += 1
+            return None
+        self._entries.move_to_end(key)
+        self.stats.hits += 1
+        value: Dict[str, Any] = json.loads(entry[0])
+        return value
+
+    async def set(
+        self, key: str, value: Dict[str, Any], ttl: Optional[float] = None
+    ) -> None:
+        """Store `value` under `key`, evicting least recently used entries."""
+        encoded = json.dumps(value, separators=(",", ":")).encode()
+        if len(encoded) > self.max_bytes:
+            return
+        if key in self._entries:
+            self._remove(key)
+        expires = time.monotonic() + ttl if ttl else None
+        self._entries[key] = (encoded, expires)
+        self.size_bytes += len(encoded)
+        while self.size_bytes > self.max_bytes:
+            oldest = next(iter(self._entries))
+            self._remove(oldest)
+            self.stats.evictions += 1
+
+    async def invalidate(self, key: str) -> None:
+        """Drop `key` from the cache."""
+        if key in self._entries:
+            self._remove(key)
+        self._fire(key)
+
+    async def clear(self) -> None:
+        """Drop every entry."""
+        self._entries.clear()
+        self.size_bytes = 0
+        self._fire(None)
+
+    def _remove(self, key: str) -> None:
+        encoded, _ = self._entries.pop(key)
+        self.size_bytes -= len(encoded)
+
+
+class RedisCache(_HookMixin):
+    """Cache shared across processes through Redis.
+
+    Requires the optional `redis` package (`pip install redis`).
+    """
+
+    def __init__(self, client: Any, prefix: str = "agent:call_model:") -> None:
+        """Wrap an existing `redis.asyncio.Redis` client."""
+        super().__init__()
+        self._client = client
+        self._prefix = prefix
+
+    @classmethod
+    def from_url(cls, url: str, **kwargs: Any) -> RedisCache:
+        """Connect to the Redis instance at `url`."""
+        redis = importlib.import_module("redis.asyncio")
+        return cls(redis.Redis.from_url(url), **kwargs)
+
+    async def get(self, key: str) -> Optional[Dict[str, Any]]:
+        """Return the cached value for `key`, or None on a miss."""
+        raw = await self._client.get(self._prefix + key)
+        if raw is None:
+            self.stats.misses += 1
+            return None
+        self.stats.hits += 1
+        value: Dict[str, Any] = json.loads(raw)
+        return value
+
+    async def set(
+        self, key: str, value: Dict[str, Any], ttl: Optional[float] = None
+    ) -> None:
+        """Store `value` under `key`, expiring after `ttl` seconds if given."""
+        px = int(ttl * 1000) if ttl else None
+        await self._client.set(self._prefix + key, json.dumps(value), px=px)
+
+    async def invalidate(self, key: str) -> None:
+        """Drop `key` from the cache."""
+        await self._client.delete(self._prefix + key)
+        self._fire(key)
+
+    async def clear(self) -> None:
+        """Drop every entry under this cache's prefix."""
+        async for key in self._client.scan_iter(match=self._prefix + "*"):
+            await self._client.delete(key)
+        self._fire(None)
@@ -0,0 +1,137 @@
+"""Bounded thread state: fold old history into a summary and cold storage.
+
+Long-lived threads append to `State.history` every turn, so without a bound
+each checkpoint (and every load) grows with the thread's age. The `compact`
+node runs after `call_model`. Once `history` is over the thread's budget
+(`Context.history_max_bytes` / `history_max_tokens`), it moves everything but
+the newest `history_keep` entries into the LangGraph store under
+`("history", <thread_id>)`, folds them into `State.summary` and drops them from
+`history`. `load_archive` reassembles the full history when needed.
+
+On LangGraph Server the store is supplied by the server. In-process graphs
+use the store from `agent.persistence` (`AGENT_STORE`); without one, compacted
+entries survive only in the summary.
+"""
+
+from __future__ import annotations
+
+import time
+from typing import Any, Dict, List, Mapping, Optional, Sequence, Tuple, Union
+
+from langgraph.store.base import BaseStore
+from typing_extensions import TypedDict
+
+from agent import metrics
+from agent.prompts import estimate_tokens
+
+SUMMARY_MAX_CHARS = 2000
+"""Upper bound on `State.summary`, so compaction itself can't grow state."""
+
+
+class HistoryDrop(TypedDict):
+    """`history` update that removes the oldest `drop` entries."""
+
+    drop: int
+
+
+def extend_history(
+    left: List[str], right: Union[List[str], HistoryDrop]
+) -> List[str]:
+    """Reducer for `State.history`: append new entries, or drop the oldest.
+
+    A plain dict stays a drop when pending writes are reloaded from a
+    checkpoint, which a list subclass would not.
+    """
+    if isinstance(right, dict):
+        return left[right["drop"] :]
+    return left + right
+
+
+def archive_namespace(thread_id: str) -> Tuple[str, ...]:
+    """Store namespace holding a thread's compacted history."""
+    return ("history", thread_id)
+
+
+def history_size(history: Sequence[str]) -> Tuple[int, int]:
+    """Return (bytes, estimated tokens) of `history`."""
+    return (
+        sum(len(entry.encode()) for entry in history),
+        sum(estimate_tokens(entry) for entry in history),
+    )
+
+
+async def summarize(previous: str, entries: Sequence[str]) -> str:
+    """Fold `entries` into the running summary `previous`.
+
+    Replace with a model call that summarizes the turns. The placeholder keeps
+    the first line of each entry and trims the oldest text so the result fits
+    `SUMMARY_MAX_CHARS`.
+    """
+    lines = [previous] if previous else []
+    lines += [entry.partition("\n")[0][:80] for entry in entries]
+    return "\n".join(lines)[-SUMMARY_MAX_CHARS:]
+
+
+async def compact_history(
+    history: Sequence[str],
+    summary: str,
+    archived: int,
+    context: Mapping[str, Any],
+    store: Optional[BaseStore],
+    thread_id: Optional[str],
+) -> Dict[str, Any]:
+    """Return the state update that brings `history` back under budget.
+
+    Returns an empty update while the thread is within budget, or when every
+    entry over the budget is among the newest `history_keep`.
+
+    Args:
+        history: The thread's current uncompacted history.
+        summary: The current `State.summary`.
+        archived: Entries archived so far; numbers the next archive chunk.
+        context: The run's `Context`.
+        store: Cold storage for the compacted entries, if any.
+        thread_id: The run's thread; archiving is skipped without one.
+    """
+    max_bytes = context.get("history_max_bytes")
+    max_tokens = context.get("history_max_tokens")
+    if not max_bytes and not max_tokens:
+        return {}
+    size_bytes, size_tokens = history_size(history)
+    if (not max_bytes or size_bytes <= max_bytes) and (
+        not max_tokens or size_tokens <= max_tokens
+    ):
+        return {}
+    keep = context.get("history_keep", 8)
+    old = list(history[: max(len(history) - keep, 0)])
+    if not old:
+        return {}
+    start = time.perf_counter()
+    if store is not None and thread_id is not None:
+        # Zero-padded so key order is chronological.
+        await store.aput(
+            archive_namespace(thread_id), f"{archived:012d}", {"entries": old}
+        )
+    new_summary = await summarize(summary, old)
+    metrics.observe("agent_compaction_seconds", time.perf_counter() - start)
+    metrics.increment("agent_compaction_archived_entries", len(old))
+    return {
+        "history": HistoryDrop(drop=len(old)),
+        "summary": new_summary,
+        "archived": len(old),
+    }
+
+
+async def load_archive(store: BaseStore, thread_id: str) -> List[str]:
+    """Return a thread's archived history entries, oldest first."""
+    items = []
+    page = 100
+    while True:
+        batch = await store.asearch(
+            archive_namespace(thread_id), limit=page, offset=len(items)
+        )
+        items.extend(batch)
+        if len(batch) < page:
+            break
+    items.sort(key=lambda item: item.key)
+    return [entry for item in items for entry in item.value["entries"]]
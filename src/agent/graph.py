@@ -5,12 +5,72 @@ Returns a predefined response. Replace logic and configuration as needed.
 
 from __future__ import annotations
 
-from dataclasses import dataclass
-from typing import Any, Dict
+import asyncio
+import json
+import operator
+import os
+import re
+import time
+import warnings
+from contextlib import aclosing, nullcontext
+from dataclasses import dataclass, field, replace
+from functools import partial
+from typing import (
+    TYPE_CHECKING,
+    Annotated,
+    Any,
+    AsyncIterator,
+    Callable,
+    Dict,
+    List,
+    Mapping,
+    Optional,
+    Sequence,
+    Set,
+    Tuple,
+    cast,
+)
 
+from langgraph.config import get_config
 from langgraph.graph import StateGraph
+from langgraph.graph.state import CompiledStateGraph
 from langgraph.runtime import Runtime
-from typing_extensions import TypedDict
+from langgraph.types import Send
+from typing_extensions import NotRequired, TypedDict
+
+from agent import metrics
+from agent.accounting import (
+    Latency,
+    RunUsage,
+    accumulate,
+    ledger,
+    split_call,
+    usage_label,
+)
+from agent.admission import guard
+from agent.cache import (
+    LRUCache,
+    RedisCache,
+    ResponseCache,
+    cache_key,
+    context_key,
+)
+from agent.compaction import compact_history, extend_history
+from agent.metrics import instrument
+from agent.persistence import checkpointer, store
+from agent.prompts import (
+    Usage,
+    build_request,
+    cached_prefix,
+    estimate_tokens,
+    merge_usage,
+)
+
+if TYPE_CHECKING:
+    from agent.batching import MicroBatcher
+    from agent.ratelimit import ModelLimiter
+    from agent.semantic_cache import SemanticCache
+    from agent.structured import FieldStream
 
 
 class Context(TypedDict):
@@ -21,6 +81,155 @@ class Context(TypedDict):
     """
 
     my_configurable_param: str
+    batch_window_ms: NotRequired[float]
+    """Coalesce concurrent `call_model` requests arriving within this window.
+
+    Batching is off unless this or `max_batch_size` is set (default 5 ms).
+    """
+    max_batch_size: NotRequired[int]
+    """Flush a batch early once it holds this many requests (default 64)."""
+    response_cache: NotRequired[bool]
+    """Serve repeated (input, context) pairs from `response_cache`."""
+    cache_ttl_s: NotRequired[float]
+    """Expire cached responses after this many seconds (default: never)."""
+    semantic_cache: NotRequired[bool]
+    """Serve near-duplicates from `get_semantic_cache()` on an exact-cache miss."""
+    semantic_cache_threshold: NotRequired[float]
+    """Minimum cosine similarity for a semantic hit (default 0.9)."""
+    stream: NotRequired[bool]
+    """Emit output incrementally to `stream_mode="custom"` as it is generated."""
+    stream_buffer_size: NotRequired[int]
+    """Max chunks read from the backend ahead of the node (default 16)."""
+    fanout_max_concurrency: NotRequired[int]
+    """Max `fanout_graph` workers calling the model at once, per process.
+
+    Counted per assistant (or `usage_label`) across all of its runs. Default 32.
+    """
+    model: NotRequired[str]
+    """Model name passed to the backend."""
+    rate_limit_key: NotRequired[str]
+    """Name of the API key/account whose limits apply (default "default")."""
+    rate_limit_rps: NotRequired[float]
+    """Sustained model requests per second for this key and model."""
+    rate_limit_burst: NotRequired[float]
+    """Token bucket capacity (default: one second of `rate_limit_rps`)."""
+    rate_limit_max_concurrency: NotRequired[int]
+    """Upper bound of the adaptive concurrency window (default 64)."""
+    rate_limit_target_latency_ms: NotRequired[float]
+    """Shrink the window when responses get slower than this."""
+    timeout_ms: NotRequired[float]
+    """Give up on the model call after this long, including queueing."""
+    deadline_unix_s: NotRequired[float]
+    """Absolute deadline (Unix time) for this run, e.g. from a client SLA.
+
+    With both set, whichever expires first applies. On expiry the in-flight
+    call is cancelled and `call_model` reports `metadata["outcome"] ==
+    "timeout"` instead of an output.
+    """
+    hedge: NotRequired[bool]
+    """Race a duplicate request when the first one is slow (not when streaming)."""
+    hedge_percentile: NotRequired[float]
+    """Fire the hedge after this rolling latency percentile (default 95)."""
+    hedge_max_ratio: NotRequired[float]
+    """Cap hedges at this fraction of calls (default 0.05)."""
+    hedge_model: NotRequired[str]
+    """Send the hedge to this model/region instead of `model`."""
+    race_models: NotRequired[List[str]]
+    """Send the request to all of these models at once (not when streaming).
+
+    The first output accepted by `race_accept` is kept and the other calls are
+    cancelled; their usage is reported in `metadata["usage_lost"]`, as is a
+    losing hedge's. Takes precedence over `hedge`.
+    """
+    race_accept: NotRequired[str]
+    """Acceptance predicate for `race_models`; see `agent.racing` (default "any")."""
+    prompt_cache: NotRequired[bool]
+    """Mark the shared prefix (tools, system prompt) cacheable by the provider.
+
+    Token counts read from and written to the provider cache are reported in
+    `metadata["usage"]`.
+    """
+    history_max_bytes: NotRequired[int]
+    """Compact `history` once its entries exceed this many bytes."""
+    history_max_tokens: NotRequired[int]
+    """Compact `history` once it exceeds this many (estimated) tokens."""
+    history_keep: NotRequired[int]
+    """Newest entries left verbatim in `history` by compaction (default 8)."""
+    job_priority: NotRequired[int]
+    """Priority of this assistant's `agent.jobqueue` jobs; higher runs first."""
+    background: NotRequired[bool]
+    """Set by `agent.jobqueue` workers on bulk runs, which yield to the rest."""
+    blob_threshold_bytes: NotRequired[int]
+    """Store larger outputs in `agent.blobs` and keep only a `BlobRef` in State.
+
+    Streamed chunks still carry the text.
+    """
+    output_schema: NotRequired[Dict[str, Any]]
+    """JSON schema of an object; `call_model` then returns structured output.
+
+    Each top-level field is streamed as `{"field": ..., "value": ...}` once
+    complete and stored in `State.fields`; see `agent.structured`.
+    """
+    max_turns: NotRequired[int]
+    """Reject runs on threads that already have this many turns."""
+    max_state_bytes: NotRequired[int]
+    """Reject runs whose State is larger (default `AGENT_MAX_STATE_BYTES`)."""
+    max_concurrent_runs: NotRequired[int]
+    """Shed this assistant's runs beyond this many at once, per process.
+
+    See `agent.admission`.
+    """
+    usage_label: NotRequired[str]
+    """Sum this run's usage under this label instead of the assistant id.
+
+    See `agent.accounting`.
+    """
+
+
+# Context keys that tune execution without changing the output. They are left
+# out of cache keys so that, e.g., a different batch window still hits.
+_EXECUTION_CONTEXT_KEYS = frozenset(
+    {
+        "batch_window_ms",
+        "max_batch_size",
+        "response_cache",
+        "cache_ttl_s",
+        "semantic_cache",
+        "semantic_cache_threshold",
+        "stream",
+        "stream_buffer_size",
+        "fanout_max_concurrency",
+        "rate_limit_key",
+        "rate_limit_rps",
+        "rate_limit_burst",
+        "rate_limit_max_concurrency",
+        "rate_limit_target_latency_ms",
+        "timeout_ms",
+        "deadline_unix_s",
+        "hedge",
+        "hedge_percentile",
+        "hedge_max_ratio",
+        "hedge_model",
+        "race_models",
+        "race_accept",
+        "prompt_cache",
+        "history_max_bytes",
+        "history_max_tokens",
+        "history_keep",
+        "job_priority",
+        "background",
+        "blob_threshold_bytes",
+        "max_turns",
+        "max_state_bytes",
+        "max_concurrent_runs",
+        "usage_label",
+    }
+)
+
+
+def merge_dicts(left: Dict[str, Any], right: Dict[str, Any]) -> Dict[str, Any]:
+    """Reducer that merges a node's keys into the existing map."""
+    return {**left, **right}
 
 
 @dataclass
@@ -29,9 +238,420 @@ class State:
 
     Defines the initial structure of incoming data.
     See: https://langchain-ai.github.io/langgraph/concepts/low_level/#state
+
+    Fields annotated with a reducer are updated with deltas: nodes return only
+    what they add (new history entries, a counter increment, changed keys),
+    and `stream_mode="updates"` carries just those deltas rather than the
+    whole state.
     """
 
     changeme: str = "example"
+    """Input, then output, text; may be an `agent.blobs.BlobRef` to large text."""
+    history: Annotated[List[str], extend_history] = field(default_factory=list)
+    """Recent outputs of `call_model`, oldest first.
+
+    Appended to every turn; `compact` drops the oldest once over budget.
+    """
+    turns: Annotated[int, operator.add] = 0
+    """Number of completed `call_model` steps."""
+    metadata: Annotated[Dict[str, Any], merge_dicts] = field(default_factory=dict)
+    """Per-run annotations; nodes return only the keys they set.
+
+    Each turn's `outcome` comes with its `reason` and `errors`, set to None
+    when they don't apply, so none are left over from an earlier turn.
+    """
+    summary: str = ""
+    """Compacted form of the history entries moved to the store."""
+    archived: Annotated[int, operator.add] = 0
+    """Number of history entries moved to the store so far."""
+    fields: Dict[str, Any] = field(default_factory=dict)
+    """Fields parsed from `changeme` when `Context.output_schema` is set.
+
+    Replaced, not merged, whenever `changeme` is: a turn without a schema
+    leaves it empty, and no field outlives the output it came from.
+    """
+
+
+ModelRequest = Tuple[str, Optional[str], bool, Optional[Dict[str, Any]]]
+"""A backend request: (input, my_configurable_param, prompt_cache, output_schema)."""
+
+
+@dataclass
+class Completion:
+    """Model output plus the provider's token accounting."""
+
+    text: str
+    usage: Usage = field(default_factory=Usage)
+    model: Optional[str] = None
+    """Model that produced the output; set by `_run_model_limited`."""
+    latency: Latency = field(default_factory=Latency)
+    """Backends may report `generation_s`; the rest is measured around them."""
+
+
+# Stands in for the provider's prompt cache so the placeholder reports
+# realistic read/write counts; remove along with the placeholder output.
+_placeholder_prefixes: Set[str] = set()
+
+
+def _placeholder_usage(payload: Dict[str, Any], output: str) -> Usage:
+    prefix = cached_prefix(payload)
+    if prefix is None:
+        return Usage(
+            input_tokens=estimate_tokens(payload), output_tokens=estimate_tokens(output)
+        )
+    stable = estimate_tokens([payload.get("tools", []), payload["system"][0]])
+    usage = Usage(
+        input_tokens=estimate_tokens([payload["system"][1:], payload["messages"]]),
+        output_tokens=estimate_tokens(output),
+    )
+    if prefix in _placeholder_prefixes:
+        usage["cache_read_input_tokens"] = stable
+    else:
+        _placeholder_prefixes.add(prefix)
+        usage["cache_creation_input_tokens"] = stable
+    return usage
+
+
+_PLACEHOLDER_VALUES: Dict[str, Any] = {
+    "integer": 0,
+    "number": 0,
+    "boolean": False,
+    "array": [],
+    "object": {},
+    "null": None,
+}
+
+
+def _placeholder_output(param: Optional[str], schema: Optional[Dict[str, Any]]) -> str:
+    text = f"output from call_model. Configured with {param}"
+    if schema is None:
+        return text
+    fields = {
+        name: _PLACEHOLDER_VALUES.get(prop.get("type", "string"), text)
+        for name, prop in schema.get("properties", {}).items()
+    }
+    return json.dumps(fields)
+
+
+async def generate(requests: Sequence[ModelRequest]) -> List[Completion]:
+    """Run a batch of requests against the model backend.
+
+    Replace with a call to your provider's batch endpoint (or a gather over
+    single calls if it has none), made through the worker's pooled client from
+    `agent.resources.get_http_client()`. Send the payload from
+    `agent.prompts.build_request` unchanged so cached prefixes stay identical.
+    Must return one completion per request, with the provider's usage.
+    Raise `agent.ratelimit.ThrottledError` when the provider answers 429.
+    """
+    completions = []
+    for user_input, param, prompt_cache, schema in requests:
+        payload = build_request(
+            user_input, param, cache_prefix=prompt_cache, output_schema=schema
+        )
+        output = _placeholder_output(param, schema)
+        completions.append(Completion(output, _placeholder_usage(payload, output)))
+    return completions
+
+
+async def stream_generate(request: ModelRequest) -> AsyncIterator[Completion]:
+    """Stream the output for a single request chunk by chunk.
+
+    Replace with your provider's streaming endpoint. Usage may arrive on any
+    chunk (typically the last); `call_model` adds them up.
+    """
+    (completion,) = await generate([request])
+    chunks = re.findall(r"\S+\s*", completion.text)
+    for i, chunk in enumerate(chunks):
+        yield Completion(chunk, completion.usage if i == len(chunks) - 1 else Usage())
+
+
+async def _timed_generate(requests: Sequence[ModelRequest]) -> List[Completion]:
+    start = time.perf_counter()
+    completions = await generate(requests)
+    elapsed = time.perf_counter() - start
+    return [replace(c, latency=split_call(c.latency, elapsed)) for c in completions]
+
+
+_batchers: Dict[Tuple[float, int], MicroBatcher[ModelRequest, Completion]] = {}
+
+
+def _get_batcher(
+    window_ms: float, max_batch_size: int
+) -> MicroBatcher[ModelRequest, Completion]:
+    from agent.batching import MicroBatcher
+
+    key = (window_ms, max_batch_size)
+    if key not in _batchers:
+        _batchers[key] = MicroBatcher(
+            _timed_generate, window=window_ms / 1000, max_batch_size=max_batch_size
+        )
+    return _batchers[key]
+
+
+def _make_response_cache() -> ResponseCache:
+    redis_url = os.environ.get("AGENT_CACHE_REDIS_URL")
+    if redis_url:
+        return RedisCache.from_url(redis_url)
+    max_bytes = int(os.environ.get("AGENT_CACHE_MAX_BYTES", 64 * 1024 * 1024))
+    return LRUCache(max_bytes=max_bytes)
+
+
+response_cache = _make_response_cache()
+"""Shared cache for `call_model` results; see `Context.response_cache`."""
+
+_semantic_cache: Optional[SemanticCache] = None
+
+
+def get_semantic_cache() -> SemanticCache:
+    """Return the near-duplicate tier behind `response_cache`, creating it once.
+
+    See `Context.semantic_cache`.
+    """
+    global _semantic_cache
+    if _semantic_cache is None:
+        from agent.semantic_cache import SemanticCache, install_persistence
+
+        _semantic_cache = SemanticCache()
+        install_persistence(_semantic_cache)
+    return _semantic_cache
+
+
+if os.environ.get("AGENT_SEMANTIC_CACHE_PATH"):
+    # Now, so its snapshot is loaded on startup.
+    get_semantic_cache()
+
+
+def response_key(state: State, context: Mapping[str, Any]) -> str:
+    """Return the `response_cache` key for a turn of `state` under `context`.
+
+    `metadata` holds per-run annotations (timings, usage totals) that never
+    change the output, so it is left out along with the execution-only keys.
+    """
+    return cache_key(
+        replace(state, metadata={}), context, ignore=_EXECUTION_CONTEXT_KEYS
+    )
+
+
+def _get_model_limiter(context: Mapping[str, Any]) -> Optional[ModelLimiter]:
+    rps = context.get("rate_limit_rps", 0.0)
+    max_concurrency = context.get("rate_limit_max_concurrency")
+    if not rps and not max_concurrency:
+        return None
+    from agent.ratelimit import LimiterConfig, get_limiter
+
+    config = LimiterConfig(
+        rps=rps,
+        burst=context.get("rate_limit_burst", 0.0),
+        max_concurrency=max_concurrency or 64,
+        target_latency_s=context.get("rate_limit_target_latency_ms", 0.0) / 1000,
+    )
+    key = context.get("rate_limit_key", "default")
+    return get_limiter(key, context.get("model", "default"), config)
+
+
+async def _run_model(
+    request: ModelRequest,
+    context: Mapping[str, Any],
+    stream_writer: Callable[[Any], None],
+) -> Completion:
+    start = time.perf_counter()
+    if context.get("stream"):
+        from agent.streaming import bounded_stream
+
+        chunks = []
+        usage = Usage()
+        first_chunk_s = None
+        source = stream_generate(request)
+        buffer_size = context.get("stream_buffer_size", 16)
+        # Closed on cancellation too, so the backend stream is released.
+        async with aclosing(bounded_stream(source, maxsize=buffer_size)) as stream:
+            async for chunk in stream:
+                if first_chunk_s is None:
+                    first_chunk_s = time.perf_counter() - start
+                stream_writer({"chunk": chunk.text})
+                chunks.append(chunk.text)
+                usage = merge_usage(usage, chunk.usage)
+        elapsed = time.perf_counter() - start
+        network_s = elapsed if first_chunk_s is None else first_chunk_s
+        latency = Latency(network_s=network_s, generation_s=elapsed - network_s)
+        return Completion("".join(chunks), usage, latency=latency)
+    window_ms = context.get("batch_window_ms")
+    max_batch_size = context.get("max_batch_size")
+    if window_ms or max_batch_size:
+        batcher = _get_batcher(window_ms or 5.0, max_batch_size or 64)
+        completion = await batcher.submit(request)
+    else:
+        (completion,) = await _timed_generate([request])
+    # Whatever the call itself didn't account for was spent waiting for the
+    # batch to flush.
+    latency = completion.latency.copy()
+    call_s = latency.get("network_s", 0.0) + latency.get("generation_s", 0.0)
+    waited = max(0.0, time.perf_counter() - start - call_s)
+    latency["queue_s"] = latency.get("queue_s", 0.0) + waited
+    return replace(completion, latency=latency)
+
+
+async def _run_model_limited(
+    request: ModelRequest,
+    context: Mapping[str, Any],
+    stream_writer: Callable[[Any], None],
+) -> Completion:
+    from agent.jobqueue import interactive_call
+
+    limiter = _get_model_limiter(context)
+    with nullcontext() if context.get("background") else interactive_call():
+        start = time.perf_counter()
+        async with limiter.slot() if limiter else nullcontext():
+            waited = time.perf_counter() - start
+            completion = await _run_model(request, context, stream_writer)
+    latency = completion.latency.copy()
+    latency["queue_s"] = latency.get("queue_s", 0.0) + waited
+    model = context.get("model", "default")
+    return replace(completion, model=model, latency=latency)
+
+
+@dataclass
+class _Attempt:
+    """One of the model calls a hedged or raced turn made."""
+
+    model: str
+    start: float
+    end: Optional[float] = None
+    completion: Optional[Completion] = None
+    """Set once the call succeeds; None if it failed or was cancelled."""
+
+
+async def _run_attempt(
+    attempts: List[_Attempt],
+    request: ModelRequest,
+    context: Mapping[str, Any],
+    stream_writer: Callable[[Any], None],
+) -> Completion:
+    """Run `_run_model_limited`, noting in `attempts` how the call went."""
+    attempt = _Attempt(context.get("model", "default"), time.perf_counter())
+    attempts.append(attempt)
+    try:
+        attempt.completion = await _run_model_limited(request, context, stream_writer)
+    finally:
+        attempt.end = time.perf_counter()
+    return attempt.completion
+
+
+def _lost_usage(
+    attempts: List[_Attempt], winner: Optional[Completion], source: str
+) -> List[RunUsage]:
+    """Return a usage record for every attempt but the `winner`."""
+    lost: List[RunUsage] = []
+    for attempt in attempts:
+        if attempt.completion is not None and attempt.completion is winner:
+            continue
+        record: Dict[str, Any] = {}
+        if attempt.completion is not None:
+            record.update(attempt.completion.usage)
+            record.update(attempt.completion.latency)
+        record.update(model=attempt.model, source=source)
+        record["total_s"] = (attempt.end or time.perf_counter()) - attempt.start
+        lost.append(cast(RunUsage, record))
+    return lost
+
+
+async def _race_models(
+    attempts: List[_Attempt],
+    request: ModelRequest,
+    context: Mapping[str, Any],
+    stream_writer: Callable[[Any], None],
+) -> Completion:
+    from agent.racing import first_accepted, get_acceptor
+
+    accept = get_acceptor(context.get("race_accept", "any"))
+    # Each branch gets its own limiter slot for its model.
+    branches = [
+        partial(_run_attempt, attempts, request, {**context, "model": m}, stream_writer)
+        for m in context["race_models"]
+    ]
+    _, completion = await first_accepted(
+        branches, lambda c: accept(c.text), name="call_model"
+    )
+    return completion
+
+
+def _time_left_s(context: Mapping[str, Any]) -> Optional[float]:
+    """Return seconds until the earliest configured deadline, if any."""
+    limits = []
+    if context.get("timeout_ms"):
+        limits.append(context["timeout_ms"] / 1000)
+    if context.get("deadline_unix_s"):
+        limits.append(context["deadline_unix_s"] - time.time())
+    return min(limits) if limits else None
+
+
+def _replay_cached(
+    cached: Dict[str, Any],
+    context: Mapping[str, Any],
+    stream_writer: Callable[[Any], None],
+) -> Dict[str, Any]:
+    if context.get("stream"):
+        stream_writer({"chunk": cached["changeme"]})
+        for name, value in cached.get("fields", {}).items():
+            stream_writer({"field": name, "value": value})
+    # Entries cached by an older version may predate some of these keys.
+    return {"fields": {}, **cached, "metadata": _outcome("ok")}
+
+
+def _with_usage(
+    result: Dict[str, Any],
+    state: State,
+    context: Mapping[str, Any],
+    usage: RunUsage,
+    start: float,
+    lost: Sequence[RunUsage] = (),
+) -> Dict[str, Any]:
+    """Attach `usage` to `result`'s metadata and add it to the ledger.
+
+    `lost` holds the hedged or raced calls that didn't produce the output;
+    they are recorded too, under their own source, in `metadata["usage_lost"]`.
+    """
+    usage["total_s"] = time.perf_counter() - start
+    label = usage_label(context, get_config())
+    ledger.record(label, usage)
+    total = accumulate(state.metadata.get("usage_total"), usage)
+    for record in lost:
+        ledger.record(label, record)
+        total = accumulate(total, record)
+    metadata = {
+        **result.get("metadata", {}),
+        "usage": dict(usage),
+        "usage_lost": [dict(record) for record in lost],
+        "usage_total": total,
+    }
+    return {**result, "metadata": metadata}
+
+
+def _outcome(outcome: str, **details: Any) -> Dict[str, Any]:
+    # `metadata` is merged, so clear what an earlier outcome may have set.
+    return {"outcome": outcome, "reason": None, "errors": None, **details}
+
+
+def _ok_result(output: str) -> Dict[str, Any]:
+    # Only deltas for the reducer fields; LangGraph folds them into State.
+    return {
+        "changeme": output,
+        "history": [output],
+        "turns": 1,
+        "fields": {},
+        "metadata": _outcome("ok"),
+    }
+
+
+async def preload_response_cache(
+    input: Mapping[str, Any], context: Mapping[str, Any], output: str
+) -> None:
+    """Cache `output` as `call_model`'s answer to `input` under `context`.
+
+    Used by `agent.warmup`; only assistants with `response_cache` read it.
+    """
+    key = response_key(State(**input), context)
+    await response_cache.set(key, _ok_result(output), ttl=context.get("cache_ttl_s"))
 
 
 async def call_model(state: State, runtime: Runtime[Context]) -> Dict[str, Any]:
@@ -39,16 +659,257 @@ async def call_model(state: State, runtime: Runtime[Context]) -> Dict[str, Any]:
 
     Can use runtime context to alter behavior.
     """
-    return {
-        "changeme": "output from call_model. "
-        f"Configured with {(runtime.context or {}).get('my_configurable_param')}"
-    }
+    # Imported here, like the other per-feature modules, to keep importing
+    # this module (and so a cold start) cheap.
+    from agent.blobs import blob_store, resolve_text
 
+    start = time.perf_counter()
+    context = runtime.context or {}
+    model = context.get("model", "default")
+    key = None
+    if context.get("response_cache"):
+        key = response_key(state, context)
+        cached = await response_cache.get(key)
+        if cached is not None:
+            # Served locally: no model tokens were spent on this turn.
+            return _with_usage(
+                _replay_cached(cached, context, runtime.stream_writer),
+                state,
+                context,
+                RunUsage(model=model, source="exact"),
+                start,
+            )
+    # Blob inputs are hashed by reference above and only fetched on a miss.
+    text = await resolve_text(state.changeme)
+    namespace = None
+    if context.get("semantic_cache"):
+        # Only the output-relevant context must match exactly. The thread's
+        # history, turns and metadata differ on every turn and would give each
+        # one a namespace of its own.
+        namespace = context_key(context, ignore=_EXECUTION_CONTEXT_KEYS)
+        similar = await get_semantic_cache().get(
+            namespace, text, context.get("semantic_cache_threshold")
+        )
+        if similar is not None:
+            return _with_usage(
+                _replay_cached(similar, context, runtime.stream_writer),
+                state,
+                context,
+                RunUsage(model=model, source="semantic"),
+                start,
+            )
 
-# Define the graph
-graph = (
-    StateGraph(State, context_schema=Context)
-    .add_node(call_model)
-    .add_edge("__start__", "call_model")
-    .compile(name="New Graph")
-)
+    schema = context.get("output_schema")
+    request = (
+        text,
+        context.get("my_configurable_param"),
+        bool(context.get("prompt_cache")),
+        schema,
+    )
+    writer: Callable[[Any], None] = runtime.stream_writer
+    fields: Optional[FieldStream] = None
+    if schema is not None:
+        from agent.structured import FieldStream
+
+        # Parses streamed chunks on their way to the client, emitting each
+        # field as soon as it is complete.
+        writer = fields = FieldStream(schema, writer)
+    attempts: List[_Attempt] = []
+    lost_source = "model"
+    if context.get("race_models") and not context.get("stream"):
+        lost_source = "race_loser"
+        call = _race_models(attempts, request, context, writer)
+    elif context.get("hedge") and not context.get("stream"):
+        from agent.hedging import get_hedger
+
+        hedger = get_hedger(
+            model,
+            context.get("hedge_percentile", 95.0),
+            context.get("hedge_max_ratio", 0.05),
+        )
+        hedge_context = {**context, "model": context.get("hedge_model", model)}
+        lost_source = "hedge_loser"
+        call = hedger.call(
+            partial(_run_attempt, attempts, request, context, writer),
+            partial(_run_attempt, attempts, request, hedge_context, writer),
+        )
+    else:
+        call = _run_model_limited(request, context, writer)
+    time_left = _time_left_s(context)
+    try:
+        if time_left is not None and time_left <= 0:
+            call.close()
+            raise asyncio.TimeoutError
+        # Cancels the model call (and frees its limiter slot) on expiry. If the
+        # run itself is aborted, LangGraph cancels this node the same way.
+        completion = await asyncio.wait_for(call, time_left)
+    except asyncio.TimeoutError:
+        metrics.increment("agent_call_model_timeouts")
+        return _with_usage(
+            {"metadata": _outcome("timeout")},
+            state,
+            context,
+            RunUsage(model=model, source="timeout"),
+            start,
+            _lost_usage(attempts, None, lost_source),
+        )
+    output = completion.text
+    threshold = context.get("blob_threshold_bytes")
+    if threshold and len(output.encode()) > threshold:
+        # Stored as a plain str so every serializer treats it like text.
+        output = str(await blob_store.put(output.encode()))
+    result = _ok_result(output)
+    if fields is not None:
+        if not fields.fed:
+            fields.parser.feed(completion.text)
+        fields.parser.close()
+        result["fields"] = fields.parser.fields
+        if fields.parser.errors:
+            metrics.increment("agent_structured_output_invalid")
+            result["metadata"] = _outcome("invalid", errors=fields.parser.errors)
+    # Invalid output isn't cached, so a retry asks the model again.
+    if key is not None and result["metadata"]["outcome"] == "ok":
+        await response_cache.set(key, result, ttl=context.get("cache_ttl_s"))
+    if namespace is not None and result["metadata"]["outcome"] == "ok":
+        await get_semantic_cache().set(namespace, text, result)
+    usage = completion.usage
+    if usage.get("cache_read_input_tokens"):
+        metrics.increment(
+            "agent_prompt_cache_read_tokens", usage["cache_read_input_tokens"]
+        )
+    if usage.get("cache_creation_input_tokens"):
+        metrics.increment(
+            "agent_prompt_cache_write_tokens", usage["cache_creation_input_tokens"]
+        )
+    record = {**usage, **completion.latency}
+    record.update(model=completion.model or model, source="model")
+    lost = _lost_usage(attempts, completion, lost_source)
+    return _with_usage(result, state, context, cast(RunUsage, record), start, lost)
+
+
+async def compact(state: State, runtime: Runtime[Context]) -> Dict[str, Any]:
+    """Keep the thread's state bounded; see `agent.compaction`."""
+    thread_id = get_config().get("configurable", {}).get("thread_id")
+    return await compact_history(
+        state.history,
+        state.summary,
+        state.archived,
+        runtime.context or {},
+        runtime.store,
+        thread_id,
+    )
+
+
+@dataclass
+class FanOutState:
+    """State for `fanout_graph`: a list of inputs mapped through `call_model`."""
+
+    items: List[str] = field(default_factory=list)
+    results: Annotated[List[Tuple[int, str]], operator.add] = field(
+        default_factory=list
+    )
+    """(index, output) pairs in completion order, written by the workers."""
+    outputs: List[str] = field(default_factory=list)
+    """Outputs in the same order as `items`."""
+
+
+class FanOutTask(TypedDict):
+    """Payload sent to each `fanout_worker`."""
+
+    index: int
+    item: str
+
+
+# One semaphore per (assistant or `Context.usage_label`, limit), shared by all
+# of that assistant's fan-out runs in this process, so its cap holds no matter
+# how many of its runs are active. Assistants don't share slots even when
+# their limits happen to be equal.
+_fanout_slots: Dict[Tuple[str, int], asyncio.Semaphore] = {}
+
+
+def fan_out(state: FanOutState) -> List[Any]:
+    """Send each item to its own worker; skip straight to `collect` if empty."""
+    if not state.items:
+        return ["collect"]
+    return [
+        Send("fanout_worker", FanOutTask(index=i, item=item))
+        for i, item in enumerate(state.items)
+    ]
+
+
+async def fanout_worker(task: FanOutTask, runtime: Runtime[Context]) -> Dict[str, Any]:
+    """Run `call_model` for one item under the concurrency cap."""
+    context = runtime.context or {}
+    limit = context.get("fanout_max_concurrency", 32)
+    key = (usage_label(context, get_config()), limit)
+    slots = _fanout_slots.setdefault(key, asyncio.Semaphore(limit))
+    async with slots:
+        result = await call_model(State(changeme=task["item"]), runtime)
+    # A timed-out item has no output; keep its slot so indices stay aligned.
+    return {"results": [(task["index"], result.get("changeme", ""))]}
+
+
+def collect(state: FanOutState) -> Dict[str, Any]:
+    """Order the gathered results by input position."""
+    return {"outputs": [output for _, output in sorted(state.results)]}
+
+
+# Define the graphs. They are compiled on first access (`agent.graph.graph`),
+# so importing this module for `State`/`Context` doesn't pay for compilation.
+def build_graph() -> CompiledStateGraph[State, Context, State, State]:
+    """Compile the single-node `agent` graph."""
+    return (
+        StateGraph(State, context_schema=Context)
+        .add_node(instrument(guard(call_model)))
+        .add_node(compact)
+        .add_edge("__start__", "call_model")
+        .add_edge("call_model", "compact")
+        .compile(name="New Graph", checkpointer=checkpointer, store=store)
+    )
+
+
+def build_fanout_graph() -> CompiledStateGraph[
+    FanOutState, Context, FanOutState, FanOutState
+]:
+    """Compile the map-reduce `agent_fanout` graph."""
+    return (
+        StateGraph(FanOutState, context_schema=Context)
+        .add_node(instrument(fanout_worker))
+        .add_node(collect)
+        .add_conditional_edges("__start__", fan_out, ["fanout_worker", "collect"])
+        .add_edge("fanout_worker", "collect")
+        .compile(name="Fan-out Graph", checkpointer=checkpointer, store=store)
+    )
+
+
+_builders: Dict[str, Callable[[], Any]] = {
+    "graph": build_graph,
+    "fanout_graph": build_fanout_graph,
+}
+
+if TYPE_CHECKING:
+    graph: CompiledStateGraph[State, Context, State, State]
+    fanout_graph: CompiledStateGraph[FanOutState, Context, FanOutState, FanOutState]
+
+
+def __getattr__(name: str) -> Any:
+    builder = _builders.get(name)
+    forwarded = not name.startswith("_") and hasattr(CompiledStateGraph, name)
+    if builder is None and forwarded:
+        # `from agent import graph` gave the compiled graph before the package
+        # loaded lazily; it is now this module. Keep `graph.ainvoke(...)` etc.
+        # working for such callers while they move to `agent.graph.graph`.
+        warnings.warn(
+            "`from agent import graph` is the agent.graph module; use "
+            "`from agent.graph import graph` for the compiled graph",
+            DeprecationWarning,
+            stacklevel=2,
+        )
+        compiled = globals()["graph"] if "graph" in globals() else __getattr__("graph")
+        return getattr(compiled, name)
+    if builder is None:
+        raise AttributeError(f"module {__name__!r} has no attribute {name!r}")
+    compiled = builder()
+    # Cache on the module so later lookups skip __getattr__ entirely.
+    globals()[name] = compiled
+    return compiled
@@ -0,0 +1,114 @@
+"""Request hedging for tail latency.
+
+If a call hasn't answered within a delay derived from recent latencies (e.g.
+the rolling p95), fire one duplicate, possibly to a different model or region,
+and keep whichever finishes first. The loser is cancelled, and awaited so its
+resources are released before the call returns. A budget keeps hedges below a
+fixed fraction of calls so they can't multiply load during an outage.
+"""
+
+from __future__ import annotations
+
+import asyncio
+import time
+from collections import deque
+from dataclasses import dataclass
+from typing import Awaitable, Callable, Deque, Dict, Optional, Set, Tuple, TypeVar
+
+from agent import metrics
+
+T = TypeVar("T")
+
+
+class LatencyTracker:
+    """Rolling window of recent latencies."""
+
+    def __init__(self, size: int = 1000, min_samples: int = 20) -> None:
+        """Keep the last `size` samples; report nothing until `min_samples`."""
+        self._samples: Deque[float] = deque(maxlen=size)
+        self.min_samples = min_samples
+
+    def add(self, latency_s: float) -> None:
+        """Record one latency."""
+        self._samples.append(latency_s)
+
+    def percentile(self, pct: float) -> Optional[float]:
+        """Return the `pct` percentile, or None while there are too few samples."""
+        if len(self._samples) < self.min_samples:
+            return None
+        ordered = sorted(self._samples)
+        index = min(len(ordered) - 1, int(len(ordered) * pct / 100))
+        return ordered[index]
+
+
+@dataclass
+class HedgeStats:
+    """Counters for one hedger."""
+
+    calls: int = 0
+    hedges_fired: int = 0
+    hedges_won: int = 0
+
+
+class Hedger:
+    """Issue hedged calls against one primary target."""
+
+    def __init__(self, name: str, percentile: float, max_ratio: float) -> None:
+        """Hedge after the `percentile` latency, for at most `max_ratio` of calls."""
+        self.name = name
+        self.percentile = percentile
+        self.max_ratio = max_ratio
+        self.latency = LatencyTracker()
+        self.stats = HedgeStats()
+
+    def _may_hedge(self) -> bool:
+        return self.stats.hedges_fired + 1 <= self.max_ratio * self.stats.calls
+
+    async def call(
+        self,
+        primary: Callable[[], Awaitable[T]],
+        hedge: Callable[[], Awaitable[T]],
+    ) -> T:
+        """Run `primary`, racing it against `hedge` if it is slow."""
+        self.stats.calls += 1
+        start = time.monotonic()
+        delay = self.latency.percentile(self.percentile)
+        first = asyncio.ensure_future(primary())
+        tasks: Set[asyncio.Future[T]] = {first}
+        try:
+            done, _ = await asyncio.wait(tasks, timeout=delay)
+            if not done and self._may_hedge():
+                self.stats.hedges_fired += 1
+                metrics.increment("agent_hedge_fired", target=self.name)
+                tasks.add(asyncio.ensure_future(hedge()))
+            while True:
+                done, _ = await asyncio.wait(
+                    tasks, return_when=asyncio.FIRST_COMPLETED
+                )
+                # Prefer a success; only fail once every attempt has failed.
+                for task in done:
+                    if task.exception() is None:
+                        if task is not first:
+                            self.stats.hedges_won += 1
+                            metrics.increment("agent_hedge_won", target=self.name)
+                        self.latency.add(time.monotonic() - start)
+                        return task.result()
+                tasks -= done
+                if not tasks:
+                    return next(iter(done)).result()
+        finally:
+            for task in tasks:
+                task.cancel()
+            # Let the losers unwind, so their usage is known once this returns.
+            await asyncio.gather(*tasks, return_exceptions=True)
+
+
+_hedgers: Dict[Tuple[str, float, float], Hedger] = {}
+
+
+def get_hedger(name: str, percentile: float, max_ratio: float) -> Hedger:
+    """Return the process-wide hedger for `name` with these settings."""
+    key = (name, percentile, max_ratio)
+    if key not in _hedgers:
+        _hedgers[key] = Hedger(name, percentile, max_ratio)
+    return _hedgers[key]
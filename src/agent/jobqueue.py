@@ -0,0 +1,511 @@
+"""Durable work queue for bulk, non-interactive runs of the `agent` graph.
+
+The server's own background runs (`client.runs.create`) share the server's
+run queue with interactive traffic and have no notion of priority. This queue
+is for offline workloads that submit many runs and only need the results
+eventually:
+
+    job_id = await queue.enqueue({"changeme": "..."}, context, key="order-17")
+
+Jobs are stored in SQLite and handed to a separate `WorkerPool` in batches,
+highest priority first. A job's priority comes from `Context.job_priority`,
+so it is set per assistant. Delivery is at-least-once: a claimed job is leased,
+its lease is renewed while it runs, and it goes back on the queue if the
+worker dies. A job whose lease expires after its last attempt fails. Each
+delivery's attempt number fences the lease, so a worker that lost its lease
+can't ack, nack or renew the redelivered job. Re-enqueueing the same
+idempotency key returns the existing job.
+Each job runs on its own thread (`job-<key>`), so with a checkpointer a
+redelivered job that already finished is acked without running again. A job
+for an assistant not in `ASSISTANTS` fails at once.
+
+Configured from the environment and started by `webapp.py` on startup:
+
+    AGENT_JOBQUEUE                  sqlite:///path/to/jobs.db (unset: off)
+    AGENT_JOBQUEUE_WORKERS          concurrent jobs per process (default 4)
+    AGENT_JOBQUEUE_BATCH            jobs claimed per dequeue (default 16)
+    AGENT_JOBQUEUE_LEASE_S          lease before redelivery (default 300)
+    AGENT_JOBQUEUE_MAX_ATTEMPTS     deliveries before a job fails (default 3)
+    AGENT_JOBQUEUE_YIELD_INFLIGHT   pause dequeueing while this many
+                                    interactive model calls run (default 8)
+
+Interactive calls are counted across processes: every server process that
+opens the queue reports its count to the queue database (when it changes, and
+at least every few seconds), and pools add up the recent reports of the
+others to their own process's count. Calls shorter than the reporting
+interval (0.5 s) may go unseen, and a process that stops reporting drops out
+after `INTERACTIVE_TTL_S`.
+"""
+
+from __future__ import annotations
+
+import asyncio
+import importlib
+import json
+import math
+import os
+import sqlite3
+import threading
+import time
+import uuid
+from contextlib import contextmanager
+from dataclasses import dataclass
+from typing import Any, Dict, Iterator, List, Mapping, Optional, Set
+
+from agent import metrics
+
+_SCHEMA = """
+CREATE TABLE IF NOT EXISTS jobs (
+    id TEXT PRIMARY KEY,
+    assistant TEXT NOT NULL,
+    priority INTEGER NOT NULL,
+    input TEXT NOT NULL,
+    context TEXT NOT NULL,
+    status TEXT NOT NULL,
+    attempts INTEGER NOT NULL DEFAULT 0,
+    lease_until REAL NOT NULL DEFAULT 0,
+    enqueued_at REAL NOT NULL,
+    result TEXT,
+    error TEXT
+);
+CREATE INDEX IF NOT EXISTS jobs_ready ON jobs (status, priority DESC, enqueued_at);
+CREATE TABLE IF NOT EXISTS interactive (
+    process TEXT PRIMARY KEY,
+    calls INTEGER NOT NULL,
+    updated_at REAL NOT NULL
+);
+"""
+
+ASSISTANTS = ("agent", "agent_fanout")
+"""Assistants jobs may name; the graph ids in `langgraph.json`."""
+
+_interactive = 0
+
+PROCESS = uuid.uuid4().hex
+"""This process's name in the `interactive` table."""
+
+INTERACTIVE_TTL_S = 5.0
+"""How long a process's reported interactive calls count."""
+
+
+@contextmanager
+def interactive_call() -> Iterator[None]:
+    """Count an interactive model call, so bulk jobs back off while it runs."""
+    global _interactive
+    _interactive += 1
+    try:
+        yield
+    finally:
+        _interactive -= 1
+
+
+@dataclass
+class Job:
+    """A claimed unit of work."""
+
+    id: str
+    assistant: str
+    input: Dict[str, Any]
+    context: Dict[str, Any]
+    attempts: int
+
+
+class JobQueue:
+    """SQLite-backed priority queue with leases and idempotency keys."""
+
+    def __init__(
+        self, path: str, *, lease_s: float = 300, max_attempts: int = 3
+    ) -> None:
+        """Open (and create if needed) the queue database at `path`."""
+        self.lease_s = lease_s
+        self.max_attempts = max_attempts
+        self._lock = threading.Lock()
+        self._db = sqlite3.connect(path, check_same_thread=False, isolation_level=None)
+        self._db.execute("PRAGMA journal_mode=WAL")
+        self._db.executescript(_SCHEMA)
+
+    @classmethod
+    def from_uri(cls, uri: str) -> JobQueue:
+        """Build a queue from `sqlite:///path` and the `AGENT_JOBQUEUE_*` env."""
+        if not uri.startswith("sqlite:"):
+            raise ValueError(f"Unsupported AGENT_JOBQUEUE: {uri!r}")
+        path = uri.removeprefix("sqlite:").removeprefix("///")
+        return cls(
+            path or ":memory:",
+            lease_s=float(os.environ.get("AGENT_JOBQUEUE_LEASE_S", 300)),
+            max_attempts=int(os.environ.get("AGENT_JOBQUEUE_MAX_ATTEMPTS", 3)),
+        )
+
+    async def _call(self, sql: str, *params: Any) -> List[Any]:
+        def run() -> List[Any]:
+            with self._lock:
+                return self._db.execute(sql, params).fetchall()
+
+        return await asyncio.to_thread(run)
+
+    async def enqueue(
+        self,
+        input: Mapping[str, Any],
+        context: Mapping[str, Any],
+        *,
+        assistant: str = "agent",
+        key: Optional[str] = None,
+    ) -> str:
+        """Add a job and return its id (the idempotency key, if given).
+
+        Enqueueing a key that already exists leaves the existing job alone.
+        """
+        job_id = key or uuid.uuid4().hex
+        await self._call(
+            "INSERT OR IGNORE INTO jobs (id, assistant, priority, input, context,"
+            " status, enqueued_at) VALUES (?, ?, ?, ?, ?, 'queued', ?)",
+            job_id,
+            assistant,
+            int(context.get("job_priority", 0)),
+            json.dumps(input),
+            json.dumps(dict(context)),
+            time.time(),
+        )
+        return job_id
+
+    async def claim(self, limit: int) -> List[Job]:
+        """Lease up to `limit` ready jobs, highest priority then oldest first.
+
+        Ready means queued, or leased by a worker whose lease has expired.
+        Expired jobs that have used all their attempts are failed instead.
+        """
+
+        def run() -> List[Job]:
+            now = time.time()
+            with self._lock:
+                self._db.execute("BEGIN IMMEDIATE")
+                try:
+                    # The worker died (or stalled) on the last attempt.
+                    self._db.execute(
+                        "UPDATE jobs SET status = 'failed',"
+                        " error = COALESCE(error, 'lease expired')"
+                        " WHERE status = 'leased' AND lease_until < ?"
+                        " AND attempts >= ?",
+                        (now, self.max_attempts),
+                    )
+                    rows = self._db.execute(
+                        "SELECT id, assistant, input, context, attempts FROM jobs"
+                        " WHERE status = 'queued'"
+                        " OR (status = 'leased' AND lease_until < ?)"
+                        " ORDER BY priority DESC, enqueued_at LIMIT ?",
+                        (now, limit),
+                    ).fetchall()
+                    self._db.executemany(
+                        "UPDATE jobs SET status = 'leased', lease_until = ?,"
+                        " attempts = attempts + 1 WHERE id = ?",
+                        [(now + self.lease_s, row[0]) for row in rows],
+                    )
+                    self._db.execute("COMMIT")
+                except BaseException:
+                    self._db.execute("ROLLBACK")
+                    raise
+            return [
+                Job(row[0], row[1], json.loads(row[2]), json.loads(row[3]), row[4] + 1)
+                for row in rows
+            ]
+
+        return await asyncio.to_thread(run)
+
+    async def _update_leased(self, job: Job, sql: str, *params: Any) -> bool:
+        # Only the delivery that holds the lease matches; a redelivery has
+        # bumped `attempts` and invalidates older copies of the job.
+        def run() -> bool:
+            with self._lock:
+                cursor = self._db.execute(
+                    f"{sql} WHERE id = ? AND status = 'leased' AND attempts = ?",
+                    (*params, job.id, job.attempts),
+                )
+                return cursor.rowcount > 0
+
+        return await asyncio.to_thread(run)
+
+    async def renew(self, jobs: List[Job]) -> None:
+        """Extend the leases of jobs that are still running."""
+        lease_until = time.time() + self.lease_s
+
+        def run() -> None:
+            with self._lock:
+                self._db.executemany(
+                    "UPDATE jobs SET lease_until = ?"
+                    " WHERE id = ? AND status = 'leased' AND attempts = ?",
+                    [(lease_until, job.id, job.attempts) for job in jobs],
+                )
+
+        if jobs:
+            await asyncio.to_thread(run)
+
+    async def ack(self, job: Job, result: Any) -> bool:
+        """Mark `job` done and store its result.
+
+        Returns False, and changes nothing, if the caller no longer holds the
+        job's lease.
+        """
+        return await self._update_leased(
+            job,
+            "UPDATE jobs SET status = 'done', result = ?",
+            json.dumps(result, default=str),
+        )
+
+    async def nack(self, job: Job, error: str) -> bool:
+        """Requeue `job`, or fail it once it has used all its attempts.
+
+        Returns False, and changes nothing, if the caller no longer holds the
+        job's lease.
+        """
+        status = "failed" if job.attempts >= self.max_attempts else "queued"
+        return await self._update_leased(
+            job, "UPDATE jobs SET status = ?, error = ?", status, error
+        )
+
+    async def fail(self, job: Job, error: str) -> bool:
+        """Fail `job` without retrying it.
+
+        Returns False, and changes nothing, if the caller no longer holds the
+        job's lease.
+        """
+        return await self._update_leased(
+            job, "UPDATE jobs SET status = 'failed', error = ?", error
+        )
+
+    async def get(self, job_id: str) -> Optional[Dict[str, Any]]:
+        """Return a job's status, attempts, result and error, if it exists."""
+        rows = await self._call(
+            "SELECT status, attempts, result, error FROM jobs WHERE id = ?", job_id
+        )
+        if not rows:
+            return None
+        status, attempts, result, error = rows[0]
+        return {
+            "id": job_id,
+            "status": status,
+            "attempts": attempts,
+            "result": json.loads(result) if result else None,
+            "error": error,
+        }
+
+    async def report_interactive(self, process: str, calls: int) -> None:
+        """Record that `process` has `calls` interactive model calls running."""
+        await self._call(
+            "INSERT OR REPLACE INTO interactive (process, calls, updated_at)"
+            " VALUES (?, ?, ?)",
+            process,
+            calls,
+            time.time(),
+        )
+
+    async def withdraw_interactive(self, process: str) -> None:
+        """Drop `process`'s report, e.g. when it shuts down."""
+        await self._call("DELETE FROM interactive WHERE process = ?", process)
+
+    async def interactive_calls(self, *, exclude: str = "") -> int:
+        """Sum the interactive calls that processes other than `exclude` report."""
+        rows = await self._call(
+            "SELECT COALESCE(SUM(calls), 0) FROM interactive"
+            " WHERE process != ? AND updated_at >= ?",
+            exclude,
+            time.time() - INTERACTIVE_TTL_S,
+        )
+        return int(rows[0][0])
+
+    async def depth(self) -> int:
+        """Number of jobs waiting to be claimed."""
+        rows = await self._call("SELECT COUNT(*) FROM jobs WHERE status = 'queued'")
+        return int(rows[0][0])
+
+
+class WorkerPool:
+    """Run claimed jobs through the graph with bounded concurrency."""
+
+    def __init__(
+        self,
+        queue: JobQueue,
+        graphs: Mapping[str, Any],
+        *,
+        concurrency: int = 4,
+        batch_size: int = 16,
+        yield_inflight: int = 8,
+        poll_interval: float = 0.5,
+    ) -> None:
+        """Create a pool; `graphs` maps assistant names to compiled graphs."""
+        self.queue = queue
+        self.graphs = graphs
+        self.concurrency = concurrency
+        self.batch_size = batch_size
+        self.yield_inflight = yield_inflight
+        self.poll_interval = poll_interval
+        self._running: Dict[str, Job] = {}
+        self._tasks: Set[asyncio.Task[None]] = set()
+        self._loop: Optional[asyncio.Task[None]] = None
+        self._last_renew = time.monotonic()
+        self._elsewhere = 0
+        self._elsewhere_at = -math.inf
+
+    async def _interactive_calls(self) -> int:
+        # Other processes' reports are read at most once per poll interval.
+        if time.monotonic() - self._elsewhere_at >= self.poll_interval:
+            self._elsewhere = await self.queue.interactive_calls(exclude=PROCESS)
+            self._elsewhere_at = time.monotonic()
+        return _interactive + self._elsewhere
+
+    async def _execute(self, job: Job) -> None:
+        try:
+            held = await self._run(job)
+        finally:
+            # Whatever happened, stop renewing the lease and free the slot.
+            self._running.pop(job.id, None)
+        if not held:
+            # Redelivered meanwhile; the newer delivery reports the outcome.
+            metrics.increment("agent_jobqueue_lost_leases", assistant=job.assistant)
+
+    async def _run(self, job: Job) -> bool:
+        graph = self.graphs.get(job.assistant)
+        if graph is None:
+            # No delivery can succeed, so don't retry.
+            metrics.increment("agent_jobqueue_failures", assistant=job.assistant)
+            return await self.queue.fail(job, f"unknown assistant {job.assistant!r}")
+        config = {"configurable": {"thread_id": f"job-{job.id}"}}
+        context = {**job.context, "background": True}
+        try:
+            previous = None
+            if getattr(graph, "checkpointer", None) is not None:
+                previous = await graph.aget_state(config)
+            if previous is not None and previous.values and not previous.next:
+                # Finished on an earlier delivery that lost its ack.
+                result = previous.values
+            else:
+                result = await graph.ainvoke(job.input, config, context=context)
+        except Exception as exc:
+            held = await self.queue.nack(job, repr(exc))
+            metrics.increment("agent_jobqueue_failures", assistant=job.assistant)
+        else:
+            held = await self.queue.ack(job, result)
+            metrics.increment("agent_jobqueue_completed", assistant=job.assistant)
+        return held
+
+    async def run_once(self) -> int:
+        """Claim and start as many jobs as there are free slots; return count."""
+        free = self.concurrency - len(self._running)
+        if free <= 0 or await self._interactive_calls() >= self.yield_inflight:
+            return 0
+        jobs = await self.queue.claim(min(free, self.batch_size))
+        for job in jobs:
+            self._running[job.id] = job
+            task = asyncio.create_task(self._execute(job))
+            self._tasks.add(task)
+            task.add_done_callback(self._tasks.discard)
+        return len(jobs)
+
+    async def _renew_leases(self) -> None:
+        if time.monotonic() - self._last_renew > self.queue.lease_s / 3:
+            await self.queue.renew(list(self._running.values()))
+            metrics.observe("agent_jobqueue_depth", await self.queue.depth())
+            self._last_renew = time.monotonic()
+
+    async def _loop_forever(self) -> None:
+        while True:
+            started = await self.run_once()
+            await self._renew_leases()
+            if not started:
+                await asyncio.sleep(self.poll_interval)
+
+    async def drain(self) -> None:
+        """Run until the queue is empty and every claimed job has finished."""
+        while await self.run_once() or self._tasks or await self.queue.depth():
+            await self._renew_leases()
+            if self._tasks:
+                await asyncio.wait(self._tasks, return_when=asyncio.FIRST_COMPLETED)
+            else:
+                await asyncio.sleep(self.poll_interval)
+
+    def start(self) -> None:
+        """Start polling in the background."""
+        self._loop = asyncio.create_task(self._loop_forever())
+
+    async def stop(self, grace: float = 0) -> None:
+        """Stop claiming and give running jobs `grace` seconds to finish.
+
+        Jobs still running after that are cancelled and redelivered later.
+        """
+        if self._loop is not None:
+            self._loop.cancel()
+        if self._tasks and grace > 0:
+            await asyncio.wait(self._tasks, timeout=grace)
+        for task in list(self._tasks):
+            task.cancel()
+        await asyncio.gather(*self._tasks, return_exceptions=True)
+
+
+class InteractiveReporter:
+    """Report this process's interactive calls to the queue database."""
+
+    def __init__(self, queue: JobQueue, *, interval: float = 0.5) -> None:
+        """Check the count every `interval` seconds."""
+        self.queue = queue
+        self.interval = interval
+        self._task: Optional[asyncio.Task[None]] = None
+
+    async def _report_forever(self) -> None:
+        reported, reported_at = -1, -math.inf
+        while True:
+            # Rewritten before it ages out, even if unchanged.
+            stale = time.monotonic() - reported_at > INTERACTIVE_TTL_S / 2
+            if _interactive != reported or stale:
+                reported, reported_at = _interactive, time.monotonic()
+                await self.queue.report_interactive(PROCESS, reported)
+            await asyncio.sleep(self.interval)
+
+    async def start(self) -> None:
+        """Start reporting in the background."""
+        self._task = asyncio.create_task(self._report_forever())
+
+    async def stop(self) -> None:
+        """Stop reporting and withdraw this process's report."""
+        if self._task is not None:
+            self._task.cancel()
+            await asyncio.gather(self._task, return_exceptions=True)
+        await self.queue.withdraw_interactive(PROCESS)
+
+
+queue: Optional[JobQueue] = None
+"""The process's queue when `AGENT_JOBQUEUE` is set; see `install`."""
+
+
+def make_pool(queue: JobQueue) -> WorkerPool:
+    """Build a pool over the `agent` graphs from the `AGENT_JOBQUEUE_*` env."""
+    graph_module = importlib.import_module("agent.graph")
+    return WorkerPool(
+        queue,
+        {"agent": graph_module.graph, "agent_fanout": graph_module.fanout_graph},
+        concurrency=int(os.environ.get("AGENT_JOBQUEUE_WORKERS", 4)),
+        batch_size=int(os.environ.get("AGENT_JOBQUEUE_BATCH", 16)),
+        yield_inflight=int(os.environ.get("AGENT_JOBQUEUE_YIELD_INFLIGHT", 8)),
+    )
+
+
+def install(*, run_pool: bool = True) -> JobQueue:
+    """Open the queue from the environment and run a pool on server startup.
+
+    With `run_pool=False` the queue only accepts jobs; `agent.workers` runs
+    them in separate processes.
+    """
+    global queue
+    from agent import resources
+
+    queue = JobQueue.from_uri(os.environ["AGENT_JOBQUEUE"])
+    reporter = InteractiveReporter(queue)
+    resources.on_startup(reporter.start)
+    resources.on_shutdown(reporter.stop)
+    if run_pool:
+        pool = make_pool(queue)
+
+        @resources.on_startup
+        async def _start() -> None:
+            pool.start()
+
+        resources.on_shutdown(pool.stop)
+    return queue
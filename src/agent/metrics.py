@@ -0,0 +1,312 @@
+"""Per-node timing and resource instrumentation.
+
+Wrap a node with `instrument` to record, for a sampled fraction of calls:
+
+- wall time,
+- time spent suspended on awaits (I/O wait) rather than running on the loop,
+- bytes of state read and written (JSON-encoded size),
+
+plus an error count for every call. Other components report their own
+histograms and counters through `observe` and `increment`. Measurements go
+to a `Recorder`; the built-in ones export Prometheus or OpenTelemetry metrics.
+
+Configured from the environment:
+
+    AGENT_METRICS              none (default), prometheus or otel
+    AGENT_METRICS_SAMPLE_RATE  fraction of calls to measure (default 0 if
+                               AGENT_METRICS is none, else 1)
+
+With sampling off, a wrapped node costs one comparison and an extra await.
+"""
+
+from __future__ import annotations
+
+import dataclasses
+import functools
+import importlib
+import json
+import os
+import random
+import time
+from typing import (
+    Any,
+    Awaitable,
+    Callable,
+    Dict,
+    Generator,
+    Generic,
+    Mapping,
+    Optional,
+    Tuple,
+    TypeVar,
+)
+
+from typing_extensions import Protocol
+
+R = TypeVar("R")
+
+
+@dataclasses.dataclass(frozen=True)
+class NodeSample:
+    """One measured node call."""
+
+    node: str
+    wall_s: float
+    io_wait_s: float
+    bytes_read: int
+    bytes_written: int
+
+
+class Recorder(Protocol):
+    """Sink for node measurements."""
+
+    def record(self, sample: NodeSample) -> None:
+        """Record a measured call."""
+        ...
+
+    def record_error(self, node: str) -> None:
+        """Count a call that raised."""
+        ...
+
+    def observe(self, name: str, value: float, labels: Mapping[str, str]) -> None:
+        """Add `value` to the histogram `name`."""
+        ...
+
+    def increment(self, name: str, amount: float, labels: Mapping[str, str]) -> None:
+        """Add `amount` to the counter `name`."""
+        ...
+
+
+class NullRecorder:
+    """Drop every measurement."""
+
+    def record(self, sample: NodeSample) -> None:
+        """Drop `sample`."""
+
+    def record_error(self, node: str) -> None:
+        """Drop the error."""
+
+    def observe(self, name: str, value: float, labels: Mapping[str, str]) -> None:
+        """Drop the observation."""
+
+    def increment(self, name: str, amount: float, labels: Mapping[str, str]) -> None:
+        """Drop the increment."""
+
+
+class PrometheusRecorder:
+    """Export to the default `prometheus_client` registry.
+
+    Requires `prometheus-client`. `webapp.py` serves it on `/metrics`.
+    """
+
+    def __init__(self) -> None:
+        """Register the node metrics."""
+        prom = importlib.import_module("prometheus_client")
+        self._prom = prom
+        self._extra: Dict[Tuple[str, Tuple[str, ...]], Any] = {}
+        self._wall = prom.Histogram(
+            "agent_node_duration_seconds", "Node wall time.", ["node"]
+        )
+        self._io_wait = prom.Histogram(
+            "agent_node_io_wait_seconds", "Node time suspended on awaits.", ["node"]
+        )
+        self._bytes = prom.Histogram(
+            "agent_node_state_bytes",
+            "JSON-encoded state size read or written by a node.",
+            ["node", "direction"],
+            buckets=[2**i for i in range(6, 27, 2)],
+        )
+        self._errors = prom.Counter(
+            "agent_node_errors", "Node calls that raised.", ["node"]
+        )
+
+    def record(self, sample: NodeSample) -> None:
+        """Observe `sample` in the histograms."""
+        self._wall.labels(sample.node).observe(sample.wall_s)
+        self._io_wait.labels(sample.node).observe(sample.io_wait_s)
+        self._bytes.labels(sample.node, "read").observe(sample.bytes_read)
+        self._bytes.labels(sample.node, "written").observe(sample.bytes_written)
+
+    def record_error(self, node: str) -> None:
+        """Increment the error counter."""
+        self._errors.labels(node).inc()
+
+    def observe(self, name: str, value: float, labels: Mapping[str, str]) -> None:
+        """Observe `value` in the histogram `name`, creating it on first use."""
+        self._metric(self._prom.Histogram, name, labels).observe(value)
+
+    def increment(self, name: str, amount: float, labels: Mapping[str, str]) -> None:
+        """Increment the counter `name`, creating it on first use."""
+        self._metric(self._prom.Counter, name, labels).inc(amount)
+
+    def _metric(self, kind: Any, name: str, labels: Mapping[str, str]) -> Any:
+        names = tuple(sorted(labels))
+        key = (name, names)
+        if key not in self._extra:
+            self._extra[key] = kind(name, name, names)
+        metric = self._extra[key]
+        return metric.labels(*(labels[n] for n in names)) if names else metric
+
+
+class OTelRecorder:
+    """Export through the OpenTelemetry metrics API.
+
+    Exporters and readers are configured by the OTel SDK as usual.
+    """
+
+    def __init__(self) -> None:
+        """Create the instruments on the `agent` meter."""
+        meter = importlib.import_module("opentelemetry.metrics").get_meter("agent")
+        self._meter = meter
+        self._extra: Dict[str, Any] = {}
+        self._wall = meter.create_histogram("agent.node.duration", unit="s")
+        self._io_wait = meter.create_histogram("agent.node.io_wait", unit="s")
+        self._bytes = meter.create_histogram("agent.node.state_bytes", unit="By")
+        self._errors = meter.create_counter("agent.node.errors")
+
+    def record(self, sample: NodeSample) -> None:
+        """Record `sample` on the histograms."""
+        attrs = {"node": sample.node}
+        self._wall.record(sample.wall_s, attrs)
+        self._io_wait.record(sample.io_wait_s, attrs)
+        self._bytes.record(sample.bytes_read, {**attrs, "direction": "read"})
+        self._bytes.record(sample.bytes_written, {**attrs, "direction": "written"})
+
+    def record_error(self, node: str) -> None:
+        """Increment the error counter."""
+        self._errors.add(1, {"node": node})
+
+    def observe(self, name: str, value: float, labels: Mapping[str, str]) -> None:
+        """Record `value` on the histogram `name`, creating it on first use."""
+        if name not in self._extra:
+            self._extra[name] = self._meter.create_histogram(name)
+        self._extra[name].record(value, dict(labels))
+
+    def increment(self, name: str, amount: float, labels: Mapping[str, str]) -> None:
+        """Add `amount` to the counter `name`, creating it on first use."""
+        if name not in self._extra:
+            self._extra[name] = self._meter.create_counter(name)
+        self._extra[name].add(amount, dict(labels))
+
+
+_recorder: Recorder = NullRecorder()
+_sample_rate = 0.0
+
+
+def configure(recorder: Recorder, sample_rate: float = 1.0) -> None:
+    """Send measurements to `recorder` for `sample_rate` of node calls."""
+    global _recorder, _sample_rate
+    _recorder = recorder
+    _sample_rate = max(0.0, min(1.0, sample_rate))
+
+
+def observe(name: str, value: float, **labels: str) -> None:
+    """Add `value` to the histogram `name` on the configured recorder."""
+    _recorder.observe(name, value, labels)
+
+
+def increment(name: str, amount: float = 1, **labels: str) -> None:
+    """Add `amount` to the counter `name` on the configured recorder."""
+    _recorder.increment(name, amount, labels)
+
+
+def configure_from_env() -> None:
+    """Apply `AGENT_METRICS` / `AGENT_METRICS_SAMPLE_RATE`."""
+    backend = os.environ.get("AGENT_METRICS", "none")
+    recorders: Dict[str, Callable[[], Recorder]] = {
+        "none": NullRecorder,
+        "prometheus": PrometheusRecorder,
+        "otel": OTelRecorder,
+    }
+    if backend not in recorders:
+        raise ValueError(f"Unsupported AGENT_METRICS: {backend!r}")
+    default_rate = "0" if backend == "none" else "1"
+    rate = float(os.environ.get("AGENT_METRICS_SAMPLE_RATE", default_rate))
+    configure(recorders[backend](), rate)
+
+
+def _encoded_size(value: Any) -> int:
+    if dataclasses.is_dataclass(value) and not isinstance(value, type):
+        value = dataclasses.asdict(value)
+    return len(json.dumps(value, separators=(",", ":"), default=str))
+
+
+class _BusyTimer(Generic[R]):
+    """Drive an awaitable, accumulating the time spent inside `send`/`throw`.
+
+    Everything else between start and finish is time the node spent
+    suspended, i.e. waiting on I/O or on other tasks.
+    """
+
+    def __init__(self, awaitable: Awaitable[R]) -> None:
+        self._steps = awaitable.__await__()
+        self.busy = 0.0
+
+    def __await__(self) -> Generator[Any, Any, R]:
+        steps = self._steps
+        value: Any = None
+        error: Optional[BaseException] = None
+        while True:
+            start = time.perf_counter()
+            try:
+                if error is None:
+                    yielded = steps.send(value)
+                else:
+                    yielded = steps.throw(error)
+            except StopIteration as stop:
+                result: R = stop.value
+                return result
+            finally:
+                self.busy += time.perf_counter() - start
+            try:
+                value, error = (yield yielded), None
+            except GeneratorExit:
+                steps.close()
+                raise
+            except BaseException as exc:
+                value, error = None, exc
+
+
+def instrument(
+    fn: Callable[..., Awaitable[R]], name: Optional[str] = None
+) -> Callable[..., Awaitable[R]]:
+    """Wrap an async node so its calls are measured.
+
+    The wrapper keeps `fn`'s name and signature, so `StateGraph.add_node`
+    registers and injects it exactly like the original.
+    """
+    node = name or getattr(fn, "__name__", "node")
+
+    @functools.wraps(fn)
+    async def wrapper(state: Any, *args: Any, **kwargs: Any) -> R:
+        if _sample_rate == 0.0 or random.random() >= _sample_rate:
+            try:
+                return await fn(state, *args, **kwargs)
+            except Exception:
+                _recorder.record_error(node)
+                raise
+
+        bytes_read = _encoded_size(state)
+        timer = _BusyTimer(fn(state, *args, **kwargs))
+        start = time.perf_counter()
+        try:
+            result: R = await timer
+        except Exception:
+            _recorder.record_error(node)
+            raise
+        wall = time.perf_counter() - start
+        _recorder.record(
+            NodeSample(
+                node=node,
+                wall_s=wall,
+                io_wait_s=max(0.0, wall - timer.busy),
+                bytes_read=bytes_read,
+                bytes_written=_encoded_size(result),
+            )
+        )
+        return result
+
+    return wrapper
+
+
+configure_from_env()
@@ -0,0 +1,231 @@
+"""Run CPU-bound node work off the event loop, and watch the loop for stalls.
+
+Synchronous work inside an `async def` node (tokenizing, schema validation,
+regex extraction, embedding post-processing) blocks every other run on the
+same loop until it returns. Move it to a bounded executor instead:
+
+    tokens = await run_cpu(tokenize, text)
+
+    @cpu_bound
+    def validate(payload: dict) -> dict: ...
+
+    @cpu_bound(processes=True)   # module-level, picklable functions only
+    def extract(text: str) -> list: ...
+
+Threads suit work that releases the GIL (hashing, regex on large inputs,
+most C extensions) and cost ~50 µs per hop. They run in a copy of the
+caller's `contextvars` context (like `asyncio.to_thread`), so tracing and
+`langgraph.config.get_config()` still work. Processes give real parallelism
+for pure-Python work but pickle arguments and results. A `cpu_bound`
+function is looked up by its qualified name in the worker process, which
+resolves to the decorator's wrapper and is unwrapped there. Submissions beyond
+each executor's size wait on a semaphore rather than an unbounded queue, and
+the wait is reported as `agent_offload_queue_seconds`.
+
+`LoopLagMonitor` measures how late a periodic timer fires and reports it as
+`agent_event_loop_lag_seconds`; lag well above the interval means some code
+is holding the loop. It runs on server startup whenever metrics are enabled.
+
+    AGENT_CPU_THREADS           thread executor size (default min(8, CPUs))
+    AGENT_CPU_PROCESSES         process executor size (default: CPUs)
+    AGENT_LOOP_LAG_INTERVAL_S   lag sampling period (default 0.25)
+"""
+
+from __future__ import annotations
+
+import asyncio
+import contextvars
+import functools
+import importlib
+import multiprocessing
+import os
+import time
+from concurrent.futures import Executor, ProcessPoolExecutor, ThreadPoolExecutor
+from typing import (
+    Any,
+    Awaitable,
+    Callable,
+    Dict,
+    Optional,
+    Tuple,
+    TypeVar,
+    cast,
+    overload,
+)
+
+from typing_extensions import ParamSpec
+
+from agent import metrics, resources
+
+P = ParamSpec("P")
+R = TypeVar("R")
+
+
+class _BoundedExecutor:
+    """An executor plus a semaphore capping work submitted to it."""
+
+    def __init__(
+        self, kind: str, factory: Callable[[int], Executor], size: int
+    ) -> None:
+        self.kind = kind
+        self.size = size
+        self._factory = factory
+        self._executor: Optional[Executor] = None
+        # Semaphores belong to one loop; tests and scripts may run several.
+        self._slots: Optional[Tuple[asyncio.AbstractEventLoop, asyncio.Semaphore]]
+        self._slots = None
+
+    async def run(self, fn: Callable[..., R], *args: Any) -> R:
+        loop = asyncio.get_running_loop()
+        if self._executor is None:
+            self._executor = self._factory(self.size)
+        if self._slots is None or self._slots[0] is not loop:
+            self._slots = (loop, asyncio.Semaphore(self.size))
+        queued = time.perf_counter()
+        async with self._slots[1]:
+            metrics.observe(
+                "agent_offload_queue_seconds",
+                time.perf_counter() - queued,
+                executor=self.kind,
+            )
+            if self.kind == "thread":
+                # Contexts can't be pickled, so only threads inherit one.
+                context = contextvars.copy_context()
+                return await loop.run_in_executor(
+                    self._executor, functools.partial(context.run, fn, *args)
+                )
+            return await loop.run_in_executor(self._executor, fn, *args)
+
+    def shutdown(self) -> None:
+        if self._executor is not None:
+            self._executor.shutdown(wait=False, cancel_futures=True)
+            self._executor = None
+        self._slots = None
+
+
+_cpus = os.cpu_count() or 1
+_executors: Dict[bool, _BoundedExecutor] = {
+    False: _BoundedExecutor(
+        "thread",
+        lambda n: ThreadPoolExecutor(n, thread_name_prefix="agent-cpu"),
+        int(os.environ.get("AGENT_CPU_THREADS", min(8, _cpus))),
+    ),
+    True: _BoundedExecutor(
+        "process",
+        # Forking a process that runs threads and an event loop is unsafe.
+        lambda n: ProcessPoolExecutor(
+            n, mp_context=multiprocessing.get_context("forkserver")
+        ),
+        int(os.environ.get("AGENT_CPU_PROCESSES", _cpus)),
+    ),
+}
+
+
+async def run_cpu(fn: Callable[..., R], *args: Any, processes: bool = False) -> R:
+    """Run `fn(*args)` on the bounded CPU executor and await the result.
+
+    Like `run_in_executor`, bind keyword arguments with `functools.partial`.
+    Cancelling the caller stops waiting but can't interrupt `fn` once it has
+    started running.
+    """
+    return await _executors[processes].run(fn, *args)
+
+
+def _call_by_name(
+    module: str, qualname: str, args: Tuple[Any, ...], kwargs: Dict[str, Any]
+) -> Any:
+    # Runs in the worker process. The name is bound to the `cpu_bound`
+    # wrapper, which is why `fn` itself can't be pickled by reference.
+    target: Any = importlib.import_module(module)
+    for part in qualname.split("."):
+        target = getattr(target, part)
+    if getattr(target, "_cpu_bound", False):
+        target = target.__wrapped__
+    return target(*args, **kwargs)
+
+
+@overload
+def cpu_bound(fn: Callable[P, R]) -> Callable[P, Awaitable[R]]: ...
+
+
+@overload
+def cpu_bound(
+    *, processes: bool = False
+) -> Callable[[Callable[P, R]], Callable[P, Awaitable[R]]]: ...
+
+
+def cpu_bound(fn: Any = None, *, processes: bool = False) -> Any:
+    """Turn a sync function into an async one that runs via `run_cpu`.
+
+    Works on graph nodes too: `add_node(cpu_bound(parse))` keeps `parse`'s
+    name and signature, so LangGraph still injects `runtime` if it asks.
+    """
+
+    def decorator(fn: Callable[P, R]) -> Callable[P, Awaitable[R]]:
+        if processes and "<locals>" in fn.__qualname__:
+            raise TypeError(
+                f"cpu_bound(processes=True) needs a module-level function, "
+                f"not {fn.__qualname__}"
+            )
+
+        @functools.wraps(fn)
+        async def wrapper(*args: P.args, **kwargs: P.kwargs) -> R:
+            if processes:
+                call = functools.partial(
+                    _call_by_name, fn.__module__, fn.__qualname__, args, kwargs
+                )
+            else:
+                call = functools.partial(fn, *args, **kwargs)
+            return cast(R, await run_cpu(call, processes=processes))
+
+        setattr(wrapper, "_cpu_bound", True)
+        return wrapper
+
+    return decorator(fn) if fn is not None else decorator
+
+
+class LoopLagMonitor:
+    """Periodically measure how late the event loop runs a scheduled wakeup."""
+
+    def __init__(self, interval: float = 0.25) -> None:
+        """Sample every `interval` seconds."""
+        self.interval = interval
+        self.max_lag = 0.0
+        self._task: Optional[asyncio.Task[None]] = None
+
+    async def _run(self) -> None:
+        while True:
+            expected = time.perf_counter() + self.interval
+            await asyncio.sleep(self.interval)
+            lag = max(0.0, time.perf_counter() - expected)
+            self.max_lag = max(self.max_lag, lag)
+            metrics.observe("agent_event_loop_lag_seconds", lag)
+
+    def start(self) -> None:
+        """Start sampling on the running loop."""
+        if self._task is None:
+            self._task = asyncio.create_task(self._run())
+
+    async def stop(self) -> None:
+        """Stop sampling."""
+        if self._task is not None:
+            self._task.cancel()
+            await asyncio.gather(self._task, return_exceptions=True)
+            self._task = None
+
+
+loop_lag = LoopLagMonitor(float(os.environ.get("AGENT_LOOP_LAG_INTERVAL_S", 0.25)))
+"""Process-wide monitor, started with the server when metrics are enabled."""
+
+
+@resources.on_startup
+async def _start() -> None:
+    if os.environ.get("AGENT_METRICS", "none") != "none":
+        loop_lag.start()
+
+
+@resources.on_shutdown
+async def _stop() -> None:
+    await loop_lag.stop()
+    for executor in _executors.values():
+        executor.shutdown()
@@ -0,0 +1,167 @@
+"""Checkpoint backend selection and tuning.
+
+When deployed on LangGraph Server, persistence is provided by the server and
+any checkpointer compiled into the graph is ignored. For self-hosted or
+in-process use (scripts, benchmarks, `agent.batch`), pick a backend with
+`AGENT_CHECKPOINTER`:
+
+    memory                         in-process `InMemorySaver`
+    sqlite:///path/to/file.db      `AsyncSqliteSaver` in WAL mode (single node)
+    postgresql://user@host/db      `AsyncPostgresSaver` on a connection pool
+
+SQLite needs `langgraph-checkpoint-sqlite`; Postgres needs
+`langgraph-checkpoint-postgres` and `psycopg-pool`. The Postgres pool is sized
+with `AGENT_CHECKPOINTER_POOL_MIN` / `AGENT_CHECKPOINTER_POOL_MAX` and opened
+by `agent.resources.startup()`, which in-process callers must await first.
+
+`AGENT_CHECKPOINT_SERDE=compact` stores checkpoints with
+`agent.serde.CompactSerializer` (msgpack, compressed at or above
+`AGENT_CHECKPOINT_COMPRESS_BYTES`, default 4096) instead of LangGraph's default.
+
+How often checkpoints are written is LangGraph's `durability` run option,
+defaulted here from `AGENT_DURABILITY`:
+
+    async   persist each superstep in the background while the next one runs,
+            so a step's checkpoint and pending writes go out as one batch
+    sync    persist each superstep before starting the next
+    exit    persist only when the run finishes; best for stateless runs like
+            this single-node graph
+
+Pass `durability=DURABILITY` to `ainvoke`/`astream`, or set `durability` when
+creating runs through the server API.
+
+`AGENT_STORE` picks the long-term store compiled into the graphs (`memory` or
+a Postgres URI, sharing the checkpointer's pool if the URI matches). It holds
+history archived by `agent.compaction`.
+"""
+
+from __future__ import annotations
+
+import importlib
+import os
+from typing import Any, Dict, Literal, Optional, cast
+
+from langgraph.checkpoint.base import BaseCheckpointSaver
+from langgraph.checkpoint.serde.base import SerializerProtocol
+from langgraph.store.base import BaseStore
+
+from agent import resources
+from agent.serde import CompactSerializer
+
+Durability = Literal["sync", "async", "exit"]
+
+DURABILITY = cast(Durability, os.environ.get("AGENT_DURABILITY", "async"))
+if DURABILITY not in ("sync", "async", "exit"):
+    raise ValueError(f"AGENT_DURABILITY must be sync, async or exit: {DURABILITY!r}")
+
+
+def make_serde(name: Optional[str]) -> Optional[SerializerProtocol]:
+    """Return the checkpoint serializer named `name`, or None for the default."""
+    if not name or name == "default":
+        return None
+    if name == "compact":
+        threshold = int(os.environ.get("AGENT_CHECKPOINT_COMPRESS_BYTES", 4096))
+        return CompactSerializer(compress_threshold=threshold)
+    raise ValueError(f"Unsupported AGENT_CHECKPOINT_SERDE: {name!r}")
+
+
+def make_checkpointer(
+    uri: Optional[str], serde: Optional[SerializerProtocol] = None
+) -> Optional[BaseCheckpointSaver[str]]:
+    """Build the checkpointer described by `uri`, or None if it is empty."""
+    if not uri:
+        return None
+    if uri == "memory":
+        from langgraph.checkpoint.memory import InMemorySaver
+
+        return InMemorySaver(serde=serde)
+    if uri.startswith("sqlite:"):
+        path = uri.removeprefix("sqlite:").removeprefix("///")
+        return _sqlite_saver(path, serde)
+    if uri.startswith(("postgres://", "postgresql://")):
+        return _postgres_saver(uri, serde)
+    raise ValueError(f"Unsupported AGENT_CHECKPOINTER: {uri!r}")
+
+
+def _sqlite_saver(
+    path: str, serde: Optional[SerializerProtocol]
+) -> BaseCheckpointSaver[str]:
+    aiosqlite = importlib.import_module("aiosqlite")
+    sqlite_aio = importlib.import_module("langgraph.checkpoint.sqlite.aio")
+    # The connection is started lazily by the saver on first use.
+    conn = aiosqlite.connect(path or ":memory:")
+    saver = sqlite_aio.AsyncSqliteSaver(conn, serde=serde)
+
+    @resources.on_startup
+    async def _tune() -> None:
+        # setup() enables WAL; NORMAL sync is durable under WAL and avoids an
+        # fsync per checkpoint.
+        await saver.setup()
+        await conn.execute("PRAGMA synchronous=NORMAL")
+
+    @resources.on_shutdown
+    async def _close() -> None:
+        await conn.close()
+
+    return cast(BaseCheckpointSaver[str], saver)
+
+
+_pools: Dict[str, Any] = {}
+
+
+def _postgres_pool(uri: str) -> Any:
+    """Return the connection pool for `uri`, opened by `resources.startup()`."""
+    if uri in _pools:
+        return _pools[uri]
+    psycopg_pool = importlib.import_module("psycopg_pool")
+    psycopg_rows = importlib.import_module("psycopg.rows")
+    pool = psycopg_pool.AsyncConnectionPool(
+        uri,
+        min_size=int(os.environ.get("AGENT_CHECKPOINTER_POOL_MIN", 2)),
+        max_size=int(os.environ.get("AGENT_CHECKPOINTER_POOL_MAX", 20)),
+        open=False,
+        kwargs={
+            "autocommit": True,
+            "prepare_threshold": 0,
+            "row_factory": psycopg_rows.dict_row,
+        },
+    )
+    resources.on_startup(pool.open)
+    resources.on_shutdown(pool.close)
+    _pools[uri] = pool
+    return pool
+
+
+def _postgres_saver(
+    uri: str, serde: Optional[SerializerProtocol]
+) -> BaseCheckpointSaver[str]:
+    postgres_aio = importlib.import_module("langgraph.checkpoint.postgres.aio")
+    saver = postgres_aio.AsyncPostgresSaver(_postgres_pool(uri), serde=serde)
+    resources.on_startup(saver.setup)
+    return cast(BaseCheckpointSaver[str], saver)
+
+
+def make_store(uri: Optional[str]) -> Optional[BaseStore]:
+    """Build the long-term store described by `uri`, or None if it is empty."""
+    if not uri:
+        return None
+    if uri == "memory":
+        from langgraph.store.memory import InMemoryStore
+
+        return InMemoryStore()
+    if uri.startswith(("postgres://", "postgresql://")):
+        postgres_aio = importlib.import_module("langgraph.store.postgres.aio")
+        store = postgres_aio.AsyncPostgresStore(_postgres_pool(uri))
+        resources.on_startup(store.setup)
+        return cast(BaseStore, store)
+    raise ValueError(f"Unsupported AGENT_STORE: {uri!r}")
+
+
+checkpointer = make_checkpointer(
+    os.environ.get("AGENT_CHECKPOINTER"),
+    serde=make_serde(os.environ.get("AGENT_CHECKPOINT_SERDE")),
+)
+"""Checkpointer compiled into `graph` for self-hosted/in-process runs."""
+
+store = make_store(os.environ.get("AGENT_STORE"))
+"""Store compiled into the graphs for self-hosted/in-process runs."""
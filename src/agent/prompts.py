@@ -0,0 +1,104 @@
+"""Request layout for the model backend, with provider-side prompt caching.
+
+Providers that cache prompts (Anthropic `cache_control`, OpenAI automatic
+prefix caching) only hit when the leading bytes of the request are identical
+to an earlier one. `build_request` therefore always emits the stable parts
+first, in a canonical form (tools sorted by name, keys sorted), and puts
+anything that varies per assistant or per call after the cache breakpoint.
+"""
+
+from __future__ import annotations
+
+import hashlib
+import json
+from typing import Any, Dict, List, Mapping, Optional, Sequence, cast
+
+from typing_extensions import TypedDict
+
+SYSTEM_PROMPT = "You are a helpful agent."
+"""Shared system prompt; the bulk of the cacheable prefix."""
+
+TOOLS: List[Dict[str, Any]] = []
+"""Tool definitions sent with every request, in provider JSON-schema form."""
+
+CACHE_CONTROL = {"type": "ephemeral"}
+
+
+class Usage(TypedDict, total=False):
+    """Token accounting for one model call, as reported by the provider."""
+
+    input_tokens: int
+    """Uncached input tokens."""
+    output_tokens: int
+    cache_read_input_tokens: int
+    """Input tokens served from the provider's prompt cache."""
+    cache_creation_input_tokens: int
+    """Input tokens written to the provider's prompt cache."""
+
+
+def _canonical(value: Any) -> Any:
+    # Round-trip through sorted JSON so dict ordering never shifts the bytes.
+    return json.loads(json.dumps(value, sort_keys=True))
+
+
+def build_request(
+    user_input: str,
+    param: Optional[str],
+    *,
+    system: str = SYSTEM_PROMPT,
+    tools: Sequence[Dict[str, Any]] = TOOLS,
+    cache_prefix: bool = False,
+    output_schema: Optional[Mapping[str, Any]] = None,
+) -> Dict[str, Any]:
+    """Return a Messages-style request with the stable prefix laid out first.
+
+    Order is tools, then `system`, then per-assistant system blocks carrying
+    `param` and the `output_schema` instructions, then the user turn. With
+    `cache_prefix`, the breakpoint goes on the last stable block so tools and
+    the system prompt are cached together.
+    """
+    tool_list = [_canonical(t) for t in sorted(tools, key=lambda t: t["name"])]
+    system_blocks: List[Dict[str, Any]] = [{"type": "text", "text": system}]
+    if cache_prefix:
+        system_blocks[-1]["cache_control"] = dict(CACHE_CONTROL)
+    if param is not None:
+        system_blocks.append({"type": "text", "text": f"Configuration: {param}"})
+    if output_schema is not None:
+        schema = json.dumps(output_schema, sort_keys=True)
+        text = f"Respond with only a JSON object matching this schema: {schema}"
+        system_blocks.append({"type": "text", "text": text})
+    request: Dict[str, Any] = {}
+    if tool_list:
+        request["tools"] = tool_list
+    request["system"] = system_blocks
+    request["messages"] = [{"role": "user", "content": user_input}]
+    return request
+
+
+def cached_prefix(request: Dict[str, Any]) -> Optional[str]:
+    """Return a hash of everything up to the cache breakpoint, if there is one.
+
+    Two requests with the same hash can share a provider cache entry; a hash
+    that changes between calls means the prefix layout isn't stable.
+    """
+    prefix: List[Any] = list(request.get("tools", []))
+    for block in request["system"]:
+        prefix.append(block)
+        if "cache_control" in block:
+            encoded = json.dumps(prefix, sort_keys=True, separators=(",", ":"))
+            return hashlib.sha256(encoded.encode()).hexdigest()
+    return None
+
+
+def estimate_tokens(value: Any) -> int:
+    """Rough token count (4 bytes per token) for providers that report none."""
+    text = value if isinstance(value, str) else json.dumps(value)
+    return max(1, len(text.encode()) // 4)
+
+
+def merge_usage(total: Usage, more: Usage) -> Usage:
+    """Add up two usage records, e.g. across streamed chunks."""
+    merged = dict(cast(Mapping[str, int], total))
+    for name, count in cast(Mapping[str, int], more).items():
+        merged[name] = merged.get(name, 0) + count
+    return cast(Usage, merged)
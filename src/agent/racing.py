@@ -0,0 +1,92 @@
+"""Speculative branches: run several strategies at once, keep the first good one.
+
+Unlike hedging, every branch starts immediately and they may differ (a small
+fast model and a large one, cached and live retrieval). Branches are checked
+in completion order against an acceptance predicate; the first that passes
+wins and the rest are cancelled so they stop consuming quota. If no branch is
+accepted, the first one that succeeded is used.
+
+Predicates are named so they can be picked from `Context.race_accept`:
+`"any"` (the default), `"nonempty"`, `"re:<pattern>"` (the output must match
+the regular expression), or a name registered with `register_acceptor`.
+"""
+
+from __future__ import annotations
+
+import asyncio
+import re
+from typing import Awaitable, Callable, Dict, List, Sequence, Set, Tuple, TypeVar
+
+from agent import metrics
+
+T = TypeVar("T")
+
+Acceptor = Callable[[str], bool]
+
+_acceptors: Dict[str, Acceptor] = {
+    "any": lambda output: True,
+    "nonempty": lambda output: bool(output.strip()),
+}
+
+
+def register_acceptor(name: str) -> Callable[[Acceptor], Acceptor]:
+    """Register a predicate under `name` for use in `Context.race_accept`."""
+
+    def decorator(fn: Acceptor) -> Acceptor:
+        _acceptors[name] = fn
+        return fn
+
+    return decorator
+
+
+def get_acceptor(spec: str) -> Acceptor:
+    """Resolve a `Context.race_accept` value to a predicate."""
+    if spec.startswith("re:"):
+        pattern = re.compile(spec[3:])
+        return lambda output: pattern.search(output) is not None
+    try:
+        return _acceptors[spec]
+    except KeyError:
+        raise ValueError(f"Unknown race_accept predicate: {spec!r}") from None
+
+
+async def first_accepted(
+    branches: Sequence[Callable[[], Awaitable[T]]],
+    accept: Callable[[T], bool],
+    *,
+    name: str = "race",
+) -> Tuple[int, T]:
+    """Run `branches` concurrently; return (index, result) of the winner.
+
+    Raises the last branch's exception if every branch failed. Cancelling the
+    caller (e.g. on a deadline) cancels every branch.
+    """
+    tasks: List[asyncio.Future[T]] = [asyncio.ensure_future(b()) for b in branches]
+    pending: Set[asyncio.Future[T]] = set(tasks)
+    fallback: List[Tuple[int, T]] = []
+    error: BaseException = RuntimeError("no branches to race")
+    try:
+        while pending:
+            done, pending = await asyncio.wait(
+                pending, return_when=asyncio.FIRST_COMPLETED
+            )
+            # Ties resolve in branch order, so earlier branches are preferred.
+            for task in sorted(done, key=tasks.index):
+                index = tasks.index(task)
+                if task.exception() is not None:
+                    error = task.exception() or error
+                    continue
+                if accept(task.result()):
+                    metrics.increment("agent_race_wins", race=name, branch=str(index))
+                    return index, task.result()
+                metrics.increment("agent_race_rejected", race=name, branch=str(index))
+                if not fallback:
+                    fallback.append((index, task.result()))
+        if fallback:
+            return fallback[0]
+        raise error
+    finally:
+        for task in tasks:
+            task.cancel()
+        # Let the losers unwind, so their usage is known once this returns.
+        await asyncio.gather(*tasks, return_exceptions=True)
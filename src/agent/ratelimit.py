@@ -0,0 +1,265 @@
+"""Adaptive rate limiting for outbound model calls.
+
+Each (API key, model) pair gets its own `ModelLimiter`:
+
+- a token bucket capping the sustained request rate and burst size, and
+- an AIMD concurrency window: it grows by about one slot per window's worth
+  of fast successes and halves on a 429 (`ThrottledError`) or when latency
+  exceeds the target, so load backs off before the provider starts throttling.
+
+Time spent waiting for a token or a slot is reported as the
+`agent_ratelimit_queue_seconds` histogram, with throttles and the current
+window alongside it.
+
+Limits are per key, not per process. With `AGENT_RATELIMIT_REDIS_URL` set,
+token buckets live in Redis and every process on the key draws from the same
+one. Otherwise, under `agent.workers`, each of the `AGENT_WORKER_COUNT`
+processes takes an equal share of the rate, burst and concurrency.
+"""
+
+from __future__ import annotations
+
+import asyncio
+import importlib
+import os
+import time
+from collections import deque
+from contextlib import asynccontextmanager
+from dataclasses import dataclass
+from typing import Any, AsyncIterator, Deque, Dict, Optional, Tuple, Union
+
+from agent import metrics
+
+
+class ThrottledError(Exception):
+    """Raised by a model backend when the provider answers 429."""
+
+    def __init__(self, retry_after: Optional[float] = None) -> None:
+        """Create the error, optionally with the provider's Retry-After."""
+        super().__init__("model provider throttled the request")
+        self.retry_after = retry_after
+
+
+class TokenBucket:
+    """Classic token bucket: `rate` tokens per second, holding up to `burst`."""
+
+    def __init__(self, rate: float, burst: float) -> None:
+        """Create a full bucket."""
+        self.rate = rate
+        self.burst = max(1.0, burst)
+        self._tokens = self.burst
+        self._updated = time.monotonic()
+        self._lock = asyncio.Lock()
+
+    async def acquire(self) -> None:
+        """Wait until a token is available and take it."""
+        async with self._lock:
+            while True:
+                now = time.monotonic()
+                elapsed = now - self._updated
+                self._tokens = min(self.burst, self._tokens + elapsed * self.rate)
+                self._updated = now
+                if self._tokens >= 1:
+                    self._tokens -= 1
+                    return
+                await asyncio.sleep((1 - self._tokens) / self.rate)
+
+    async def pause(self, seconds: float) -> None:
+        """Drain the bucket so no token is handed out for `seconds`."""
+        self._tokens = min(self._tokens, 0.0) - seconds * self.rate
+
+
+# Refill by elapsed time, then take one token (KEYS[1], rate, burst, 1) or
+# drain for a Retry-After (rate, burst, -seconds). Returns the seconds to wait
+# before retrying, 0 if a token was taken.
+_BUCKET_SCRIPT = """
+local rate, burst, op = tonumber(ARGV[1]), tonumber(ARGV[2]), tonumber(ARGV[3])
+local t = redis.call('TIME')
+local now = tonumber(t[1]) + tonumber(t[2]) / 1e6
+local state = redis.call('HMGET', KEYS[1], 'tokens', 'ts')
+local tokens = tonumber(state[1]) or burst
+local ts = tonumber(state[2]) or now
+tokens = math.min(burst, tokens + math.max(0, now - ts) * rate)
+local wait = 0
+if op < 0 then
+  tokens = math.min(tokens, 0) + op * rate
+elseif tokens >= 1 then
+  tokens = tokens - 1
+else
+  wait = (1 - tokens) / rate
+end
+redis.call('HSET', KEYS[1], 'tokens', tokens, 'ts', now)
+redis.call('PEXPIRE', KEYS[1], math.ceil((burst - tokens) / rate * 1000) + 1000)
+return tostring(wait)
+"""
+
+
+class RedisTokenBucket:
+    """`TokenBucket` whose state is shared through Redis by every process."""
+
+    def __init__(self, client: Any, key: str, rate: float, burst: float) -> None:
+        """Use the bucket stored at `key` on an existing `redis.asyncio` client."""
+        self.rate = rate
+        self.burst = max(1.0, burst)
+        self._key = key
+        self._script = client.register_script(_BUCKET_SCRIPT)
+
+    async def _eval(self, op: float) -> float:
+        args = [self.rate, self.burst, op]
+        return float(await self._script(keys=[self._key], args=args))
+
+    async def acquire(self) -> None:
+        """Wait until a token is available and take it."""
+        while (wait := await self._eval(1)) > 0:
+            await asyncio.sleep(wait)
+
+    async def pause(self, seconds: float) -> None:
+        """Drain the shared bucket so no process gets a token for `seconds`."""
+        await self._eval(-seconds)
+
+
+_redis: Optional[Any] = None
+
+
+def _shared_client() -> Optional[Any]:
+    global _redis
+    url = os.environ.get("AGENT_RATELIMIT_REDIS_URL")
+    if url and _redis is None:
+        _redis = importlib.import_module("redis.asyncio").Redis.from_url(url)
+    return _redis
+
+
+def process_share() -> int:
+    """Number of processes splitting a limit that isn't shared through Redis."""
+    return max(1, int(os.environ.get("AGENT_WORKER_COUNT", 1)))
+
+
+class AIMDWindow:
+    """Concurrency limit that adapts with additive increase, multiplicative decrease."""
+
+    def __init__(self, initial: float, minimum: float, maximum: float) -> None:
+        """Create a window starting at `initial` slots."""
+        self.minimum = max(1.0, minimum)
+        self.maximum = max(self.minimum, maximum)
+        self.limit = min(self.maximum, max(self.minimum, initial))
+        self.inflight = 0
+        self._waiters: Deque[asyncio.Future[None]] = deque()
+
+    async def acquire(self) -> None:
+        """Wait for a free slot."""
+        if self.inflight < int(self.limit) and not self._waiters:
+            self.inflight += 1
+            return
+        future: asyncio.Future[None] = asyncio.get_running_loop().create_future()
+        self._waiters.append(future)
+        try:
+            await future
+        except asyncio.CancelledError:
+            if future.done() and not future.cancelled():
+                # We were handed a slot just as we were cancelled.
+                self.release()
+            else:
+                self._waiters.remove(future)
+            raise
+
+    def release(self) -> None:
+        """Return a slot and wake waiters that now fit in the window."""
+        self.inflight -= 1
+        self._wake()
+
+    def on_success(self) -> None:
+        """Grow the window by 1/limit, i.e. about one slot per full window."""
+        self.limit = min(self.maximum, self.limit + 1 / self.limit)
+        self._wake()
+
+    def on_overload(self) -> None:
+        """Halve the window."""
+        self.limit = max(self.minimum, self.limit / 2)
+
+    def _wake(self) -> None:
+        while self._waiters and self.inflight < int(self.limit):
+            future = self._waiters.popleft()
+            if not future.done():
+                self.inflight += 1
+                future.set_result(None)
+
+
+@dataclass(frozen=True)
+class LimiterConfig:
+    """Per-assistant limiter settings, taken from `Context`."""
+
+    rps: float = 0.0
+    """Sustained requests per second; 0 disables the token bucket."""
+    burst: float = 0.0
+    """Bucket capacity (default: one second of `rps`)."""
+    max_concurrency: int = 64
+    """Upper bound for the adaptive window."""
+    target_latency_s: float = 0.0
+    """Treat slower responses as overload; 0 reacts to 429s only."""
+
+
+class ModelLimiter:
+    """Token bucket plus AIMD window for one (API key, model) pair."""
+
+    def __init__(self, key: str, model: str, config: LimiterConfig) -> None:
+        """Create a limiter; the window starts at a quarter of its maximum."""
+        self.labels = {"key": key, "model": model}
+        self.config = config
+        client = _shared_client()
+        share = 1 if client is not None else process_share()
+        self.bucket: Optional[Union[TokenBucket, RedisTokenBucket]] = None
+        if config.rps and client is not None:
+            self.bucket = RedisTokenBucket(
+                client,
+                f"agent:ratelimit:{key}:{model}",
+                config.rps,
+                config.burst or config.rps,
+            )
+        elif config.rps:
+            burst = config.burst or config.rps
+            self.bucket = TokenBucket(config.rps / share, burst / share)
+        # The concurrency window adapts locally; only its ceiling is split.
+        maximum = max(1, config.max_concurrency // process_share())
+        self.window = AIMDWindow(
+            initial=max(1, maximum // 4), minimum=1, maximum=maximum
+        )
+
+    @asynccontextmanager
+    async def slot(self) -> AsyncIterator[None]:
+        """Hold a rate-limited slot for the duration of one model call."""
+        queued = time.monotonic()
+        if self.bucket is not None:
+            await self.bucket.acquire()
+        await self.window.acquire()
+        started = time.monotonic()
+        metrics.observe(
+            "agent_ratelimit_queue_seconds", started - queued, **self.labels
+        )
+        try:
+            yield
+        except ThrottledError as exc:
+            self.window.on_overload()
+            if self.bucket is not None and exc.retry_after:
+                await self.bucket.pause(exc.retry_after)
+            metrics.increment("agent_ratelimit_throttled", **self.labels)
+            raise
+        else:
+            target = self.config.target_latency_s
+            if target and time.monotonic() - started > target:
+                self.window.on_overload()
+            else:
+                self.window.on_success()
+        finally:
+            self.window.release()
+            metrics.observe("agent_ratelimit_window", self.window.limit, **self.labels)
+
+
+_limiters: Dict[Tuple[str, str, LimiterConfig], ModelLimiter] = {}
+
+
+def get_limiter(key: str, model: str, config: LimiterConfig) -> ModelLimiter:
+    """Return the process-wide limiter for `key`/`model` with `config`."""
+    cache_key = (key, model, config)
+    if cache_key not in _limiters:
+        _limiters[cache_key] = ModelLimiter(key, model, config)
+    return _limiters[cache_key]
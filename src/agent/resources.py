@@ -0,0 +1,200 @@
+"""Process-wide resources shared by graph nodes.
+
+Outbound HTTP goes through one pooled, keep-alive `httpx.AsyncClient` per
+worker instead of a client per invocation. The server opens it on startup and
+closes it on shutdown via `lifespan` (wired up in `webapp.py`); in-process
+callers such as tests get one lazily on first use.
+
+Pool settings are per worker, so they come from the environment rather than
+from `Context`:
+
+    AGENT_HTTP_MAX_CONNECTIONS      total connections in the pool (default 100)
+    AGENT_HTTP_MAX_KEEPALIVE        idle connections kept open (default 20)
+    AGENT_HTTP_MAX_PER_HOST         concurrent requests per host (default 0: unlimited)
+    AGENT_HTTP_KEEPALIVE_EXPIRY_S   idle connection lifetime (default 30)
+    AGENT_HTTP_CONNECT_TIMEOUT_S    connect timeout (default 5)
+    AGENT_HTTP_TIMEOUT_S            read/write/pool timeout (default 60)
+    AGENT_HTTP2                     use HTTP/2 when `h2` is installed (default 1)
+"""
+
+from __future__ import annotations
+
+import asyncio
+import importlib
+import os
+from contextlib import asynccontextmanager
+from dataclasses import dataclass
+from typing import Any, AsyncIterator, Awaitable, Callable, Dict, List, Optional
+
+import httpx
+
+
+@dataclass(frozen=True)
+class HTTPPoolConfig:
+    """Connection pool settings for the shared HTTP client."""
+
+    max_connections: int = 100
+    max_keepalive_connections: int = 20
+    max_connections_per_host: int = 0
+    keepalive_expiry: float = 30.0
+    connect_timeout: float = 5.0
+    timeout: float = 60.0
+    http2: bool = True
+
+    @classmethod
+    def from_env(cls) -> HTTPPoolConfig:
+        """Read settings from `AGENT_HTTP_*` environment variables."""
+        env = os.environ
+        return cls(
+            max_connections=int(env.get("AGENT_HTTP_MAX_CONNECTIONS", 100)),
+            max_keepalive_connections=int(env.get("AGENT_HTTP_MAX_KEEPALIVE", 20)),
+            max_connections_per_host=int(env.get("AGENT_HTTP_MAX_PER_HOST", 0)),
+            keepalive_expiry=float(env.get("AGENT_HTTP_KEEPALIVE_EXPIRY_S", 30)),
+            connect_timeout=float(env.get("AGENT_HTTP_CONNECT_TIMEOUT_S", 5)),
+            timeout=float(env.get("AGENT_HTTP_TIMEOUT_S", 60)),
+            http2=env.get("AGENT_HTTP2", "1") not in ("0", "false", "False"),
+        )
+
+
+class _ReleasingStream(httpx.AsyncByteStream):
+    """Response body that releases a per-host slot once it is closed."""
+
+    def __init__(
+        self, stream: httpx.AsyncByteStream, release: Callable[[], None]
+    ) -> None:
+        self._stream = stream
+        self._release: Optional[Callable[[], None]] = release
+
+    async def __aiter__(self) -> AsyncIterator[bytes]:
+        async for chunk in self._stream:
+            yield chunk
+
+    async def aclose(self) -> None:
+        try:
+            await self._stream.aclose()
+        finally:
+            if self._release is not None:
+                self._release()
+                self._release = None
+
+
+class PerHostLimitTransport(httpx.AsyncBaseTransport):
+    """Cap concurrent in-flight requests per host on top of the pool limits.
+
+    A slot is held from sending the request until its response body is closed.
+    """
+
+    def __init__(self, transport: httpx.AsyncBaseTransport, limit: int) -> None:
+        """Wrap `transport`, allowing at most `limit` requests per host."""
+        self._transport = transport
+        self._limit = limit
+        self._slots: Dict[str, asyncio.Semaphore] = {}
+
+    async def handle_async_request(self, request: httpx.Request) -> httpx.Response:
+        """Send `request` once a slot for its host is free."""
+        host = request.url.host
+        slot = self._slots.setdefault(host, asyncio.Semaphore(self._limit))
+        await slot.acquire()
+        try:
+            response = await self._transport.handle_async_request(request)
+        except BaseException:
+            slot.release()
+            raise
+        assert isinstance(response.stream, httpx.AsyncByteStream)
+        return httpx.Response(
+            status_code=response.status_code,
+            headers=response.headers,
+            stream=_ReleasingStream(response.stream, slot.release),
+            extensions=response.extensions,
+        )
+
+    async def aclose(self) -> None:
+        """Close the wrapped transport."""
+        await self._transport.aclose()
+
+
+def _h2_available() -> bool:
+    # Import rather than look up the spec: a broken or partial install would
+    # otherwise make httpx raise when the client is created.
+    try:
+        importlib.import_module("h2")
+    except ImportError:
+        return False
+    return True
+
+
+def create_http_client(config: HTTPPoolConfig) -> httpx.AsyncClient:
+    """Build a pooled keep-alive client from `config`."""
+    # HTTP/2 needs the optional `h2` package (`pip install httpx[http2]`);
+    # without it we still get HTTP/1.1 keep-alive pooling.
+    http2 = config.http2 and _h2_available()
+    transport: httpx.AsyncBaseTransport = httpx.AsyncHTTPTransport(
+        http2=http2,
+        limits=httpx.Limits(
+            max_connections=config.max_connections,
+            max_keepalive_connections=config.max_keepalive_connections,
+            keepalive_expiry=config.keepalive_expiry,
+        ),
+    )
+    if config.max_connections_per_host > 0:
+        transport = PerHostLimitTransport(transport, config.max_connections_per_host)
+    return httpx.AsyncClient(
+        transport=transport,
+        timeout=httpx.Timeout(config.timeout, connect=config.connect_timeout),
+    )
+
+
+_http_client: Optional[httpx.AsyncClient] = None
+
+
+def get_http_client() -> httpx.AsyncClient:
+    """Return the worker's shared HTTP client, creating it if needed."""
+    global _http_client
+    if _http_client is None or _http_client.is_closed:
+        _http_client = create_http_client(HTTPPoolConfig.from_env())
+    return _http_client
+
+
+Hook = Callable[[], Awaitable[None]]
+
+_startup_hooks: List[Hook] = []
+_shutdown_hooks: List[Hook] = []
+
+
+def on_startup(hook: Hook) -> Hook:
+    """Register `hook` to run when the server starts, after the HTTP pool opens."""
+    _startup_hooks.append(hook)
+    return hook
+
+
+def on_shutdown(hook: Hook) -> Hook:
+    """Register `hook` to run when the server stops, before the HTTP pool closes."""
+    _shutdown_hooks.append(hook)
+    return hook
+
+
+async def startup() -> None:
+    """Open shared resources. Called once when the server starts."""
+    get_http_client()
+    for hook in _startup_hooks:
+        await hook()
+
+
+async def shutdown() -> None:
+    """Close shared resources. Called once when the server stops."""
+    global _http_client
+    for hook in reversed(_shutdown_hooks):
+        await hook()
+    if _http_client is not None:
+        await _http_client.aclose()
+        _http_client = None
+
+
+@asynccontextmanager
+async def lifespan(app: Any) -> AsyncIterator[None]:
+    """ASGI lifespan that brackets the server's lifetime with startup/shutdown."""
+    await startup()
+    try:
+        yield
+    finally:
+        await shutdown()
@@ -0,0 +1,349 @@
+"""Embedding-based cache tier for near-duplicate inputs.
+
+Inputs are embedded and looked up in an in-memory HNSW graph; a cached
+response is served when the nearest stored input is at least `threshold`
+cosine-similar. Entries are partitioned by namespace (`call_model` uses the
+output-relevant `Context` values), so only requests configured the same way
+match. Namespaces are kept in LRU order, and the least recently used index
+is dropped once there are more than `max_namespaces`. A full namespace keeps
+its newer half: the smaller index is built on the CPU executor while lookups
+and inserts carry on against the old one, then swapped in.
+
+Indexes live in each worker process. With `AGENT_SEMANTIC_CACHE_PATH` set,
+a worker loads that JSON snapshot on startup and writes its own on shutdown
+(atomically; the last worker to stop wins), so entries survive restarts and
+reach new workers, but are not shared live between running ones.
+
+The default embedder hashes character trigrams into a fixed-size vector. It
+is cheap and catches typos, casing and word-order changes, but not true
+paraphrases; plug in a provider embedding model for those.
+"""
+
+from __future__ import annotations
+
+import asyncio
+import hashlib
+import heapq
+import json
+import math
+import operator
+import os
+import random
+import time
+from collections import OrderedDict
+from typing import Any, Awaitable, Callable, Dict, List, Optional, Set, Tuple
+
+from agent import metrics, resources
+from agent.cache import CacheStats
+from agent.offload import run_cpu
+
+Vector = List[float]
+Embedder = Callable[[str], Awaitable[Vector]]
+
+
+def _dot(a: Vector, b: Vector) -> float:
+    return sum(map(operator.mul, a, b))
+
+
+def _normalize(vector: Vector) -> Vector:
+    norm = math.sqrt(_dot(vector, vector)) or 1.0
+    return [x / norm for x in vector]
+
+
+def trigram_embedding(text: str, dim: int = 128) -> Vector:
+    """Return a normalized feature-hashed bag of character trigrams."""
+    vector = [0.0] * dim
+    padded = f"  {' '.join(text.lower().split())}  "
+    for i in range(len(padded) - 2):
+        digest = hashlib.blake2b(padded[i : i + 3].encode(), digest_size=4).digest()
+        h = int.from_bytes(digest, "little")
+        vector[h % dim] += 1.0 if h & 0x80000000 else -1.0
+    return _normalize(vector)
+
+
+OFFLOAD_CHARS = 4096
+"""Inputs longer than this are embedded on the CPU executor, not the loop."""
+
+
+async def default_embedder(text: str) -> Vector:
+    """Embed `text` with `trigram_embedding`."""
+    if len(text) > OFFLOAD_CHARS:
+        return await run_cpu(trigram_embedding, text)
+    return trigram_embedding(text)
+
+
+class HNSWIndex:
+    """Hierarchical navigable small-world graph over normalized vectors.
+
+    Similarity is the dot product, i.e. cosine similarity for unit vectors.
+    """
+
+    def __init__(
+        self,
+        m: int = 12,
+        ef_construction: int = 48,
+        ef_search: int = 24,
+        seed: int = 0,
+    ) -> None:
+        """Create an empty index.
+
+        Args:
+            m: Neighbors kept per node on upper layers (2*m on layer 0).
+            ef_construction: Candidate list size while inserting.
+            ef_search: Candidate list size while searching.
+            seed: Seed for level assignment.
+        """
+        self.m = m
+        self.ef_construction = ef_construction
+        self.ef_search = ef_search
+        self._level_mult = 1 / math.log(max(2, m))
+        self._random = random.Random(seed)
+        self.vectors: List[Vector] = []
+        self.values: List[Any] = []
+        # _layers[level][node] -> neighbor ids
+        self._layers: List[Dict[int, List[int]]] = []
+        self._entry: Optional[int] = None
+        self._entry_level = -1
+
+    def __len__(self) -> int:
+        """Return the number of stored vectors."""
+        return len(self.vectors)
+
+    def _search_layer(
+        self, query: Vector, entries: List[int], ef: int, level: int
+    ) -> List[Tuple[float, int]]:
+        """Return up to `ef` (similarity, id) pairs on `level`, best first."""
+        layer = self._layers[level]
+        visited: Set[int] = set(entries)
+        scored = [(_dot(query, self.vectors[e]), e) for e in entries]
+        candidates = [(-sim, node) for sim, node in scored]  # max-heap
+        heapq.heapify(candidates)
+        best = list(scored)  # min-heap of the current top `ef`
+        heapq.heapify(best)
+        while len(best) > ef:
+            heapq.heappop(best)
+        while candidates:
+            neg_sim, node = heapq.heappop(candidates)
+            if best and -neg_sim < best[0][0] and len(best) >= ef:
+                break
+            for neighbor in layer.get(node, ()):
+                if neighbor in visited:
+                    continue
+                visited.add(neighbor)
+                sim = _dot(query, self.vectors[neighbor])
+                if len(best) < ef or sim > best[0][0]:
+                    heapq.heappush(candidates, (-sim, neighbor))
+                    heapq.heappush(best, (sim, neighbor))
+                    if len(best) > ef:
+                        heapq.heappop(best)
+        return sorted(best, reverse=True)
+
+    def _connect(self, node: int, neighbors: List[int], level: int) -> None:
+        limit = self.m * 2 if level == 0 else self.m
+        layer = self._layers[level]
+        layer[node] = neighbors[:limit]
+        for other in neighbors[:limit]:
+            links = layer.setdefault(other, [])
+            links.append(node)
+            if len(links) > limit:
+                vec = self.vectors[other]
+                links.sort(key=lambda n: _dot(vec, self.vectors[n]), reverse=True)
+                del links[limit:]
+
+    def add(self, vector: Vector, value: Any) -> int:
+        """Insert a unit `vector` carrying `value`; return its id."""
+        node = len(self.vectors)
+        self.vectors.append(vector)
+        self.values.append(value)
+        level = int(-math.log(1 - self._random.random()) * self._level_mult)
+        while len(self._layers) <= level:
+            self._layers.append({})
+        if self._entry is None:
+            for lvl in range(level + 1):
+                self._layers[lvl][node] = []
+            self._entry, self._entry_level = node, level
+            return node
+
+        entry_level = self._entry_level
+        entries = [self._entry]
+        for lvl in range(entry_level, level, -1):
+            entries = [self._search_layer(vector, entries, 1, lvl)[0][1]]
+        for lvl in range(min(level, entry_level), -1, -1):
+            found = self._search_layer(vector, entries, self.ef_construction, lvl)
+            self._connect(node, [n for _, n in found], lvl)
+            entries = [n for _, n in found]
+        for lvl in range(entry_level + 1, level + 1):
+            self._layers[lvl][node] = []
+        if level > entry_level:
+            self._entry, self._entry_level = node, level
+        return node
+
+    def search(self, vector: Vector, k: int = 1) -> List[Tuple[float, Any]]:
+        """Return up to `k` (similarity, value) pairs nearest to `vector`."""
+        if self._entry is None:
+            return []
+        entries = [self._entry]
+        for lvl in range(self._entry_level, 0, -1):
+            entries = [self._search_layer(vector, entries, 1, lvl)[0][1]]
+        found = self._search_layer(vector, entries, max(self.ef_search, k), 0)
+        return [(sim, self.values[n]) for sim, n in found[:k]]
+
+
+def _build_index(
+    vectors: List[Vector], values: List[Any], m: int, ef_construction: int, ef: int
+) -> HNSWIndex:
+    index = HNSWIndex(m, ef_construction, ef)
+    for vector, value in zip(vectors, values):
+        index.add(vector, value)
+    return index
+
+
+class SemanticCache:
+    """Namespaced nearest-neighbour response cache."""
+
+    def __init__(
+        self,
+        embedder: Embedder = default_embedder,
+        threshold: float = 0.9,
+        max_entries: int = 10_000,
+        max_namespaces: int = 256,
+    ) -> None:
+        """Create a cache.
+
+        Args:
+            embedder: Async function mapping text to a unit vector.
+            threshold: Default minimum cosine similarity for a hit.
+            max_entries: Per-namespace capacity; the oldest half is dropped
+                (by rebuilding the index off the loop) once it is reached.
+            max_namespaces: Number of namespaces kept; the least recently
+                used one is dropped when it is exceeded.
+        """
+        self.embedder = embedder
+        self.threshold = threshold
+        self.max_entries = max_entries
+        self.max_namespaces = max_namespaces
+        self.stats = CacheStats()
+        self._indexes: OrderedDict[str, HNSWIndex] = OrderedDict()
+        self._rebuilds: Dict[str, asyncio.Task[None]] = {}
+
+    def __len__(self) -> int:
+        """Return the number of namespaces."""
+        return len(self._indexes)
+
+    async def get(
+        self, namespace: str, text: str, threshold: Optional[float] = None
+    ) -> Optional[Dict[str, Any]]:
+        """Return the response cached for the nearest similar input, if any."""
+        start = time.perf_counter()
+        index = self._indexes.get(namespace)
+        hit: Optional[Dict[str, Any]] = None
+        if index is not None:
+            self._indexes.move_to_end(namespace)
+            matches = index.search(await self.embedder(text), k=1)
+            limit = self.threshold if threshold is None else threshold
+            if matches and matches[0][0] >= limit:
+                hit = dict(matches[0][1])
+        metrics.observe(
+            "agent_semantic_cache_lookup_seconds", time.perf_counter() - start
+        )
+        if hit is None:
+            self.stats.misses += 1
+        else:
+            self.stats.hits += 1
+        return hit
+
+    async def set(self, namespace: str, text: str, value: Dict[str, Any]) -> None:
+        """Cache `value` as the response for `text`."""
+        vector = await self.embedder(text)
+        index = self._indexes.setdefault(namespace, HNSWIndex())
+        self._indexes.move_to_end(namespace)
+        index.add(vector, dict(value))
+        if len(index) >= self.max_entries and namespace not in self._rebuilds:
+            # Keep the newer half of what is there now.
+            rebuild = self._rebuild(namespace, index, len(index) // 2, len(index))
+            task = asyncio.create_task(rebuild)
+            self._rebuilds[namespace] = task
+            task.add_done_callback(lambda _: self._rebuilds.pop(namespace, None))
+        while len(self._indexes) > self.max_namespaces:
+            _, dropped = self._indexes.popitem(last=False)
+            self.stats.evictions += len(dropped)
+
+    async def _rebuild(
+        self, namespace: str, index: HNSWIndex, start: int, end: int
+    ) -> None:
+        fresh = await run_cpu(
+            _build_index,
+            index.vectors[start:end],
+            index.values[start:end],
+            index.m,
+            index.ef_construction,
+            index.ef_search,
+        )
+        if self._indexes.get(namespace) is not index:
+            return  # Dropped meanwhile, and counted as evicted then.
+        # Entries added during the build are few; insert them here, in order.
+        for vector, value in zip(index.vectors[end:], index.values[end:]):
+            fresh.add(vector, value)
+        self._indexes[namespace] = fresh
+        self.stats.evictions += start
+
+    async def flush(self) -> None:
+        """Wait for rebuilds in progress to be swapped in."""
+        while self._rebuilds:
+            await asyncio.gather(*self._rebuilds.values())
+
+    async def save(self, path: str) -> None:
+        """Write every namespace's entries to `path` as JSON, atomically."""
+        await self.flush()
+        snapshot = {
+            namespace: {"vectors": index.vectors, "values": index.values}
+            for namespace, index in self._indexes.items()
+        }
+
+        def write() -> None:
+            tmp = f"{path}.{os.getpid()}.tmp"
+            with open(tmp, "w") as f:
+                json.dump(snapshot, f, separators=(",", ":"), default=str)
+            os.replace(tmp, path)
+
+        await asyncio.to_thread(write)
+
+    async def load(self, path: str) -> None:
+        """Add the namespaces saved in `path`, if it exists."""
+
+        def read() -> Dict[str, HNSWIndex]:
+            try:
+                with open(path) as f:
+                    snapshot = json.load(f)
+            except FileNotFoundError:
+                return {}
+            template = HNSWIndex()
+            return {
+                namespace: _build_index(
+                    entries["vectors"][-self.max_entries :],
+                    entries["values"][-self.max_entries :],
+                    template.m,
+                    template.ef_construction,
+                    template.ef_search,
+                )
+                for namespace, entries in snapshot.items()
+            }
+
+        self._indexes.update(await asyncio.to_thread(read))
+        while len(self._indexes) > self.max_namespaces:
+            self._indexes.popitem(last=False)
+
+
+def install_persistence(cache: SemanticCache) -> None:
+    """Load and save `cache` at `AGENT_SEMANTIC_CACHE_PATH`, if it is set."""
+    path = os.environ.get("AGENT_SEMANTIC_CACHE_PATH")
+    if not path:
+        return
+
+    @resources.on_startup
+    async def _load() -> None:
+        await cache.load(path)
+
+    @resources.on_shutdown
+    async def _save() -> None:
+        await cache.save(path)
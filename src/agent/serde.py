@@ -0,0 +1,81 @@
+"""Compressed serialization for checkpoints.
+
+Checkpointers serialize each channel value on its own, in `put` and
+`put_writes`: for the `agent` graph that means a `str`, a list of history
+entries, an `int` or a metadata dict, never the `State` dataclass itself. So
+`CompactSerializer` leaves the encoding to LangGraph's default serializer
+(already msgpack) and only compresses a value's payload once it reaches a
+size threshold. It uses zstd if the `zstd` extra (`zstandard`) is
+installed, and zlib otherwise. Long history lists and large outputs shrink
+the most.
+"""
+
+from __future__ import annotations
+
+import importlib.util
+import zlib
+from typing import Any, Optional, Tuple
+
+from langgraph.checkpoint.serde.base import SerializerProtocol
+from langgraph.checkpoint.serde.jsonplus import JsonPlusSerializer
+
+_ZSTD = importlib.util.find_spec("zstandard") is not None
+
+
+def _compress(data: bytes, level: int) -> Tuple[str, bytes]:
+    if _ZSTD:
+        zstd = importlib.import_module("zstandard")
+        return "zstd", zstd.ZstdCompressor(level=level).compress(data)
+    return "zlib", zlib.compress(data, min(level, 9))
+
+
+def _decompress(codec: str, data: bytes) -> bytes:
+    if codec == "zstd":
+        zstd = importlib.import_module("zstandard")
+        out: bytes = zstd.ZstdDecompressor().decompress(data)
+        return out
+    if codec == "zlib":
+        return zlib.decompress(data)
+    raise ValueError(f"unknown compression {codec!r}")
+
+
+class CompactSerializer(SerializerProtocol):
+    """Checkpoint serializer that compresses large payloads.
+
+    Type tags are the fallback's, e.g. `msgpack`, with `+zstd` or `+zlib`
+    appended when the payload is compressed.
+    """
+
+    def __init__(
+        self,
+        fallback: Optional[SerializerProtocol] = None,
+        compress_threshold: int = 4096,
+        compress_level: int = 3,
+    ) -> None:
+        """Create a serializer.
+
+        Args:
+            fallback: Serializer that encodes values before compression.
+            compress_threshold: Compress payloads of at least this many bytes.
+            compress_level: zstd/zlib compression level.
+        """
+        self.fallback = fallback or JsonPlusSerializer()
+        self.compress_threshold = compress_threshold
+        self.compress_level = compress_level
+
+    def dumps_typed(self, obj: Any) -> Tuple[str, bytes]:
+        """Serialize `obj` to a (type tag, bytes) pair."""
+        tag, data = self.fallback.dumps_typed(obj)
+        if len(data) >= self.compress_threshold:
+            compression, compressed = _compress(data, self.compress_level)
+            if len(compressed) < len(data):
+                return f"{tag}+{compression}", compressed
+        return tag, data
+
+    def loads_typed(self, data: Tuple[str, bytes]) -> Any:
+        """Deserialize a pair produced by `dumps_typed`."""
+        tag, payload = data
+        if "+" in tag:
+            tag, compression = tag.rsplit("+", 1)
+            payload = _decompress(compression, payload)
+        return self.fallback.loads_typed((tag, payload))
@@ -0,0 +1,74 @@
+"""Bounded relaying of incremental node output.
+
+A producer task drains the backend stream into a fixed-size queue while the
+node forwards items to LangGraph's stream writer. This bounds only the
+producer side: when the node loop falls behind, the queue fills and the
+producer stops reading from the backend, so at most `maxsize` chunks wait
+in the node. It is not end-to-end backpressure. LangGraph's stream writer
+does not block, so a slow client is buffered by the server, not here.
+"""
+
+from __future__ import annotations
+
+import asyncio
+from typing import AsyncGenerator, AsyncIterator, Generic, TypeVar, Union
+
+T = TypeVar("T")
+
+
+class _Done:
+    pass
+
+
+class _Failed:
+    def __init__(self, exc: BaseException) -> None:
+        self.exc = exc
+
+
+class _Item(Generic[T]):
+    __slots__ = ("value",)
+
+    def __init__(self, value: T) -> None:
+        self.value = value
+
+
+async def bounded_stream(
+    source: AsyncIterator[T], maxsize: int
+) -> AsyncGenerator[T, None]:
+    """Yield items from `source`, reading at most `maxsize` ahead of the caller.
+
+    If the caller stops early, the producer is cancelled and awaited and
+    `source` is closed before this generator finishes.
+    """
+    queue: asyncio.Queue[Union[_Item[T], _Done, _Failed]] = asyncio.Queue(
+        maxsize=max(1, maxsize)
+    )
+
+    async def produce() -> None:
+        try:
+            async for item in source:
+                await queue.put(_Item(item))
+        except Exception as exc:
+            await queue.put(_Failed(exc))
+        else:
+            await queue.put(_Done())
+
+    producer = asyncio.create_task(produce())
+    try:
+        while True:
+            message = await queue.get()
+            if isinstance(message, _Done):
+                return
+            if isinstance(message, _Failed):
+                raise message.exc
+            yield message.value
+    finally:
+        # Stop reading from the backend if the consumer goes away early.
+        producer.cancel()
+        try:
+            await producer
+        except asyncio.CancelledError:
+            pass
+        aclose = getattr(source, "aclose", None)
+        if aclose is not None:
+            await aclose()
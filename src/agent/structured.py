@@ -0,0 +1,212 @@
+"""Structured output: parse a JSON object while it streams, field by field.
+
+With `Context.output_schema` set to a JSON schema for an object, `call_model`
+asks the model for one JSON object and feeds its text to `FieldParser` as it
+arrives. Each top-level property is emitted on `stream_mode="custom"` as
+`{"field": name, "value": value}` as soon as its value is complete, so
+clients can act on early fields before generation finishes. The completed
+fields land in `State.fields`.
+
+Each character is scanned once and each value decoded once, when it
+completes, so the work per chunk is linear in the chunk's size. Only the text
+of the value (or key) in progress is kept; the rest is dropped once scanned. A string,
+object or array value is complete at its closing quote or bracket; a number,
+boolean or null is complete at the comma or brace that follows it. Text
+before the opening brace (e.g. a Markdown fence) is skipped.
+
+Each completed field is checked against its property's `type` and `enum`,
+and `required` is checked at the end. This is a small subset of JSON Schema,
+so it needs no extra dependency. Problems are collected in `errors` rather
+than raised, and `call_model` reports them as
+`metadata["outcome"] == "invalid"`.
+"""
+
+from __future__ import annotations
+
+import json
+from collections import deque
+from typing import Any, Callable, Deque, Dict, List, Mapping, Optional, Tuple
+
+_TYPES: Dict[str, Tuple[type, ...]] = {
+    "string": (str,),
+    "integer": (int,),
+    "number": (int, float),
+    "boolean": (bool,),
+    "array": (list,),
+    "object": (dict,),
+    "null": (type(None),),
+}
+
+
+def check_field(name: str, value: Any, schema: Mapping[str, Any]) -> Optional[str]:
+    """Return why `value` doesn't satisfy `schema`'s `type`/`enum`, if it doesn't."""
+    types = schema.get("type")
+    if isinstance(types, str):
+        types = [types]
+    if types:
+        # bool is an int subclass but not a JSON number.
+        ok = any(
+            isinstance(value, _TYPES.get(t, (object,)))
+            and not (isinstance(value, bool) and t in ("integer", "number"))
+            for t in types
+        )
+        if not ok:
+            return f"{name}: expected {' or '.join(types)}, got {value!r}"
+    if "enum" in schema and value not in schema["enum"]:
+        return f"{name}: {value!r} is not one of {schema['enum']!r}"
+    return None
+
+
+class FieldParser:
+    """Incremental parser for one JSON object's top-level fields."""
+
+    def __init__(self, schema: Mapping[str, Any]) -> None:
+        """Parse text for an object described by `schema`."""
+        self.schema = schema
+        self.fields: Dict[str, Any] = {}
+        """Fields completed so far, in the order they were generated."""
+        self.errors: List[str] = []
+        self.done = False
+        # Text not yet dropped, as fed; `_base` is where it starts in the whole
+        # text, which the positions below index.
+        self._chunks: Deque[str] = deque()
+        self._base = 0
+        self._end = 0
+        self._depth = 0
+        self._state = "start"
+        self._in_string = False
+        self._escape = False
+        self._token_start = 0
+        self._value_start = 0
+        self._key = ""
+
+    def feed(self, text: str) -> List[Tuple[str, Any]]:
+        """Consume `text`; return the (name, value) pairs it completed."""
+        completed: List[Tuple[str, Any]] = []
+        start = self._end
+        self._chunks.append(text)
+        self._end += len(text)
+        for i, c in enumerate(text, start):
+            if self.done:
+                break
+            self._step(i, c, completed)
+        self._drop_scanned()
+        return completed
+
+    def _drop_scanned(self) -> None:
+        if self.done:
+            keep = self._end
+        elif self._state == "value":
+            keep = self._value_start
+        elif self._state == "key" and self._in_string:
+            keep = self._token_start
+        else:
+            keep = self._end
+        while self._chunks and self._base + len(self._chunks[0]) <= keep:
+            self._base += len(self._chunks.popleft())
+        if self._chunks and keep > self._base:
+            self._chunks[0] = self._chunks[0][keep - self._base :]
+            self._base = keep
+
+    def _text(self, start: int, end: int) -> str:
+        # Join at most once per value; later values reuse the joined chunk.
+        if len(self._chunks) > 1:
+            self._chunks = deque(["".join(self._chunks)])
+        return self._chunks[0][start - self._base : end - self._base]
+
+    def _step(self, i: int, c: str, completed: List[Tuple[str, Any]]) -> None:
+        if self._in_string:
+            if self._escape:
+                self._escape = False
+            elif c == "\\":
+                self._escape = True
+            elif c == '"':
+                self._in_string = False
+                if self._depth == 1 and self._state == "key":
+                    self._key = json.loads(self._text(self._token_start, i + 1))
+                    self._state = "colon"
+                elif self._depth == 1 and self._state == "value":
+                    self._emit(self._value_start, i + 1, completed)
+            return
+        if c.isspace():
+            return
+        if self._depth == 0:
+            # Skip anything before the object, such as a Markdown fence.
+            if c == "{" and self._state == "start":
+                self._depth = 1
+                self._state = "key"
+            return
+        if self._depth == 1 and self._state == "colon":
+            if c == ":":
+                self._state = "before_value"
+            return
+        if self._depth == 1 and self._state == "before_value":
+            self._value_start = i
+            self._state = "value"
+        if c == '"':
+            self._in_string = True
+            self._token_start = i
+        elif c in "{[":
+            self._depth += 1
+        elif c in "}]":
+            self._depth -= 1
+            if self._depth == 1 and self._state == "value":
+                self._emit(self._value_start, i + 1, completed)
+            elif self._depth == 0:
+                if self._state == "value":
+                    self._emit(self._value_start, i, completed)
+                self.done = True
+        elif c == "," and self._depth == 1:
+            if self._state == "value":
+                self._emit(self._value_start, i, completed)
+            self._state = "key"
+
+    def _emit(self, start: int, end: int, completed: List[Tuple[str, Any]]) -> None:
+        self._state = "after_value"
+        name = self._key
+        text = self._text(start, end)
+        try:
+            value = json.loads(text)
+        except ValueError:
+            self.errors.append(f"{name}: invalid JSON {text!r}")
+            return
+        properties = self.schema.get("properties", {})
+        if name in properties:
+            error = check_field(name, value, properties[name])
+            if error is not None:
+                self.errors.append(error)
+        self.fields[name] = value
+        completed.append((name, value))
+
+    def close(self) -> None:
+        """Check that the object was complete and has its required fields."""
+        if not self.done:
+            self.errors.append("output is not a complete JSON object")
+        missing = [f for f in self.schema.get("required", []) if f not in self.fields]
+        if missing:
+            self.errors.append(f"missing required fields: {missing}")
+
+
+class FieldStream:
+    """Stream writer that also emits each completed field of the streamed text.
+
+    Wraps `runtime.stream_writer`: `{"chunk": text}` events are forwarded and
+    then fed to `parser`, followed by one `{"field": ..., "value": ...}` event
+    per field they complete.
+    """
+
+    def __init__(
+        self, schema: Mapping[str, Any], writer: Callable[[Any], None]
+    ) -> None:
+        """Parse chunks written through this object against `schema`."""
+        self.parser = FieldParser(schema)
+        self.fed = False
+        self._writer = writer
+
+    def __call__(self, event: Any) -> None:
+        """Forward `event`, then any fields its chunk completed."""
+        self._writer(event)
+        if isinstance(event, dict) and "chunk" in event:
+            self.fed = True
+            for name, value in self.parser.feed(event["chunk"]):
+                self._writer({"field": name, "value": value})
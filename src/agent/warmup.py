@@ -0,0 +1,211 @@
+"""Warm a worker up before it takes traffic.
+
+Without this, the first requests after a deploy or scale-up pay for imports,
+graph compilation, DNS and TLS to the provider, and cold caches. Set
+`AGENT_WARMUP` in the env file that `langgraph.json` points at:
+
+    AGENT_WARMUP=1               compile the graphs (imports included)
+    AGENT_WARMUP=warmup.json     do what the file below describes
+
+    {
+      "graphs": ["graph", "fanout_graph"],
+      "connect": ["https://api.example.com"],
+      "connections_per_host": 4,
+      "invocations": [{"input": {"changeme": "hi"}, "context": {}}],
+      "cache": "hot_cache.jsonl",
+      "timeout_s": 120
+    }
+
+`connect` opens that many keep-alive connections per URL in the shared HTTP
+pool. `invocations` run through the `agent` graph with `usage_label`
+"warmup", so they don't count toward any assistant's usage. With a
+checkpointer, each one gets a new thread (`warmup-<boot id>-<i>`), so a
+restart never continues the previous boot's warm-up threads. Each line of
+`cache` is `{"input": ..., "context": ..., "output": ...}` and preloads the
+response cache. Relative paths are resolved against the spec file.
+
+Warm-up runs as a startup hook, so the server finishes starting (and its `/ok`
+health check passes) only once it is done. It runs after the persistence hooks
+that open connection pools and set up the checkpointer, and warms the same
+`agent.graph` module that serves traffic: `langgraph.json` names the graphs by
+module, not by file, so the server doesn't load a second copy. Job worker
+processes warm up before claiming jobs. `GET /ready` reports the result. A
+step that fails, or an `AGENT_WARMUP` spec that can't be loaded, is logged and
+recorded in `errors`; it never stops the worker from starting.
+"""
+
+from __future__ import annotations
+
+import asyncio
+import dataclasses
+import importlib
+import json
+import logging
+import os
+import time
+import uuid
+from dataclasses import dataclass, field
+from typing import Any, Dict, List, Optional
+
+from agent import metrics, resources
+
+logger = logging.getLogger(__name__)
+
+
+@dataclass
+class WarmupSpec:
+    """What to do on startup; see the module docstring."""
+
+    graphs: List[str] = field(default_factory=lambda: ["graph", "fanout_graph"])
+    connect: List[str] = field(default_factory=list)
+    connections_per_host: int = 1
+    invocations: List[Dict[str, Any]] = field(default_factory=list)
+    cache: Optional[str] = None
+    timeout_s: float = 120.0
+
+    @classmethod
+    def load(cls, value: str) -> WarmupSpec:
+        """Parse an `AGENT_WARMUP` value: a flag or the path of a JSON spec."""
+        if value in ("1", "true", "True"):
+            return cls()
+        with open(value) as f:
+            raw = json.load(f)
+        known = {spec_field.name for spec_field in dataclasses.fields(cls)}
+        unknown = set(raw) - known
+        if unknown:
+            raise ValueError(f"Unknown AGENT_WARMUP keys: {sorted(unknown)}")
+        spec = cls(**raw)
+        if spec.cache is not None:
+            base = os.path.dirname(os.path.abspath(value))
+            spec.cache = os.path.join(base, spec.cache)
+        return spec
+
+
+status: Dict[str, Any] = {"ready": False}
+"""Outcome of the last warm-up, served on `GET /ready`."""
+
+
+async def _connect(url: str, count: int) -> None:
+    client = resources.get_http_client()
+    # Concurrent requests each take their own pooled connection.
+    await asyncio.gather(*(client.head(url) for _ in range(count)))
+
+
+async def _preload_cache(path: str, graph_module: Any) -> int:
+    count = 0
+    with open(path) as f:
+        for line in f:
+            if not line.strip():
+                continue
+            entry = json.loads(line)
+            await graph_module.preload_response_cache(
+                entry["input"], entry.get("context", {}), entry["output"]
+            )
+            count += 1
+    return count
+
+
+async def _invoke(
+    graph: Any, thread_prefix: str, index: int, invocation: Dict[str, Any]
+) -> None:
+    config: Dict[str, Any] = {}
+    if getattr(graph, "checkpointer", None) is not None:
+        config = {"configurable": {"thread_id": f"{thread_prefix}-{index}"}}
+    context = {"usage_label": "warmup", **invocation.get("context", {})}
+    await graph.ainvoke(
+        invocation["input"], config, context=context, durability="exit"
+    )
+
+
+async def _steps(spec: WarmupSpec, report: Dict[str, Any]) -> None:
+    def failed(step: str, exc: BaseException) -> None:
+        logger.warning("warm-up step %s failed: %r", step, exc)
+        report["errors"].append(f"{step}: {exc!r}")
+
+    graph_module = importlib.import_module("agent.graph")
+    for name in spec.graphs:
+        try:
+            getattr(graph_module, name)
+            report["graphs"] += 1
+        except Exception as exc:
+            failed(f"graph {name}", exc)
+    connected = await asyncio.gather(
+        *(_connect(url, spec.connections_per_host) for url in spec.connect),
+        return_exceptions=True,
+    )
+    for url, result in zip(spec.connect, connected):
+        if isinstance(result, BaseException):
+            failed(f"connect {url}", result)
+        else:
+            report["connections"] += spec.connections_per_host
+    if spec.cache is not None:
+        try:
+            report["cache_entries"] = await _preload_cache(spec.cache, graph_module)
+        except Exception as exc:
+            failed("cache", exc)
+    thread_prefix = f"warmup-{uuid.uuid4().hex}"
+    results = await asyncio.gather(
+        *(
+            _invoke(graph_module.graph, thread_prefix, i, invocation)
+            for i, invocation in enumerate(spec.invocations)
+        ),
+        return_exceptions=True,
+    )
+    for i, result in enumerate(results):
+        if isinstance(result, BaseException):
+            failed(f"invocation {i}", result)
+        else:
+            report["invocations"] += 1
+
+
+async def warm_up(spec: WarmupSpec) -> Dict[str, Any]:
+    """Run `spec`, record the outcome in `status` and return it."""
+    start = time.perf_counter()
+    report: Dict[str, Any] = {
+        "ready": False,
+        "graphs": 0,
+        "connections": 0,
+        "cache_entries": 0,
+        "invocations": 0,
+        "errors": [],
+    }
+    status.clear()
+    status.update(report)
+    try:
+        await asyncio.wait_for(_steps(spec, report), spec.timeout_s)
+    except asyncio.TimeoutError:
+        logger.warning("warm-up timed out after %ss", spec.timeout_s)
+        report["errors"].append(f"timed out after {spec.timeout_s}s")
+    report["seconds"] = time.perf_counter() - start
+    report["ready"] = True
+    metrics.observe("agent_warmup_seconds", report["seconds"])
+    status.update(report)
+    logger.info("warm-up finished in %.2fs", report["seconds"])
+    return report
+
+
+_installed = False
+
+
+def install() -> None:
+    """Warm up on startup if `AGENT_WARMUP` is set; otherwise report ready."""
+    global _installed
+    value = os.environ.get("AGENT_WARMUP")
+    if not value:
+        status["ready"] = True
+        return
+    if _installed:
+        return
+    _installed = True
+    try:
+        spec = WarmupSpec.load(value)
+    except Exception as exc:
+        logger.exception("could not load AGENT_WARMUP=%r; skipping warm-up", value)
+        status.update(ready=True, errors=[f"AGENT_WARMUP: {exc!r}"])
+        return
+    # Registers the pool and checkpointer setup hooks, so they run first.
+    importlib.import_module("agent.persistence")
+
+    @resources.on_startup
+    async def _warm_up() -> None:
+        await warm_up(spec)
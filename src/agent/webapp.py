@@ -0,0 +1,139 @@
+"""Custom HTTP app mounted by the LangGraph server.
+
+Its lifespan opens and closes the shared resources in `agent.resources`, and
+with `AGENT_METRICS=prometheus` it serves node metrics on `/metrics`. With
+`AGENT_JOBQUEUE` set it runs the bulk job workers and serves `POST /jobs`
+(body: `input`, `context`, optional `assistant` and `key`) and
+`GET /jobs/{id}`. With `AGENT_WORKERS` also set, jobs run in the separate
+processes of `agent.workers`, restarted one by one on `POST /workers/restart`.
+With `AGENT_BLOB_STORE` set, `POST /blobs` stores a request body (up to
+`AGENT_BLOB_MAX_BYTES`) and returns its `BlobRef` for use in run inputs, and
+`GET /blobs/{ref}` reads one back. `GET /usage` returns this process's
+per-assistant token and latency totals from `agent.accounting`, and
+`GET /ready` the outcome of the startup warm-up configured by `AGENT_WARMUP`
+(see `agent.warmup`). With admission limits configured, run-creating requests
+are refused with 413/429/503 under overload (see `agent.admission`).
+Registered under `http.app` in `langgraph.json`.
+"""
+
+import importlib
+import os
+from typing import Any, List
+
+from starlette.applications import Starlette
+from starlette.middleware import Middleware
+from starlette.requests import Request
+from starlette.responses import JSONResponse, Response
+from starlette.routing import Mount, Route
+
+from agent import admission, blobs, jobqueue, warmup, workers
+from agent.accounting import ledger
+from agent.blobs import blob_store, release
+from agent.resources import lifespan
+
+
+async def get_usage(request: Request) -> JSONResponse:
+    """Return this process's usage totals per assistant and model."""
+    return JSONResponse(ledger.snapshot())
+
+
+async def get_ready(request: Request) -> JSONResponse:
+    """Return the warm-up outcome; 503 until it has finished."""
+    ready = warmup.status["ready"]
+    return JSONResponse(warmup.status, status_code=200 if ready else 503)
+
+
+# First, so later startup hooks (job workers) only run once warm-up is done.
+warmup.install()
+blobs.install()
+routes: List[Any] = [
+    Route("/usage", get_usage, methods=["GET"]),
+    Route("/ready", get_ready, methods=["GET"]),
+]
+if os.environ.get("AGENT_METRICS") == "prometheus":
+    prometheus_client = importlib.import_module("prometheus_client")
+    routes.append(Mount("/metrics", app=prometheus_client.make_asgi_app()))
+
+if os.environ.get("AGENT_JOBQUEUE"):
+    multiprocess = bool(os.environ.get("AGENT_WORKERS"))
+    queue = jobqueue.install(run_pool=not multiprocess)
+    if multiprocess:
+        workers.install()
+
+    async def submit_job(request: Request) -> JSONResponse:
+        """Enqueue a job from the JSON body and return its id, or 422."""
+        body = await request.json()
+        assistant = body.get("assistant", "agent")
+        if assistant not in jobqueue.ASSISTANTS:
+            detail = f"unknown assistant {assistant!r}"
+            return JSONResponse({"detail": detail}, status_code=422)
+        job_id = await queue.enqueue(
+            body.get("input", {}),
+            body.get("context", {}),
+            assistant=assistant,
+            key=body.get("key"),
+        )
+        return JSONResponse({"id": job_id}, status_code=202)
+
+    async def get_job(request: Request) -> JSONResponse:
+        """Return a job's status and result, or 404."""
+        job = await queue.get(request.path_params["job_id"])
+        if job is None:
+            return JSONResponse({"detail": "not found"}, status_code=404)
+        return JSONResponse(job)
+
+    routes.append(Route("/jobs", submit_job, methods=["POST"]))
+    routes.append(Route("/jobs/{job_id}", get_job, methods=["GET"]))
+
+    async def restart_workers(request: Request) -> JSONResponse:
+        """Start a rolling restart of the job worker processes."""
+        if not workers.restart():
+            return JSONResponse({"detail": "no worker processes"}, status_code=409)
+        return JSONResponse({"restarting": True}, status_code=202)
+
+    if multiprocess:
+        routes.append(Route("/workers/restart", restart_workers, methods=["POST"]))
+
+if os.environ.get("AGENT_BLOB_STORE"):
+    max_blob_bytes = int(os.environ.get("AGENT_BLOB_MAX_BYTES", 64 * 1024 * 1024))
+
+    async def put_blob(request: Request) -> JSONResponse:
+        """Store the request body, up to `AGENT_BLOB_MAX_BYTES`, as a blob."""
+        too_large = JSONResponse({"detail": "body_bytes"}, status_code=413)
+        length = request.headers.get("content-length", "")
+        if length.isdigit() and int(length) > max_blob_bytes:
+            return too_large
+        # Counted as it arrives, since the header may be absent or wrong.
+        chunks: List[bytes] = []
+        size = 0
+        async for chunk in request.stream():
+            size += len(chunk)
+            if size > max_blob_bytes:
+                return too_large
+            chunks.append(chunk)
+        ref = await blob_store.put(b"".join(chunks))
+        return JSONResponse({"ref": ref}, status_code=201)
+
+    async def get_blob(request: Request) -> Response:
+        """Return the bytes behind a `BlobRef`, or 400/404."""
+        try:
+            data = await blob_store.get(request.path_params["ref"])
+        except ValueError:
+            return JSONResponse({"detail": "invalid blob ref"}, status_code=400)
+        except KeyError:
+            return Response(status_code=404)
+        try:
+            body = bytes(data)
+        finally:
+            release(data)
+        return Response(body, media_type="application/octet-stream")
+
+    routes.append(Route("/blobs", put_blob, methods=["POST"]))
+    routes.append(Route("/blobs/{ref}", get_blob, methods=["GET"]))
+
+middleware: List[Middleware] = []
+if admission.enabled():
+    # Custom app middleware also covers the server's own run endpoints.
+    middleware.append(Middleware(admission.AdmissionMiddleware))
+
+app = Starlette(routes=routes, lifespan=lifespan, middleware=middleware)
@@ -0,0 +1,214 @@
+"""Multi-process workers for `agent.jobqueue`, to use every core in a container.
+
+One process runs at most one core's worth of graph code, because the GIL
+serializes CPU work in nodes. The supervisor started by `python -m
+agent.workers` runs `AGENT_WORKERS` worker processes. Each one runs a
+`jobqueue.WorkerPool` against the shared SQLite queue, which leases jobs with
+`BEGIN IMMEDIATE`, so no two processes claim the same job.
+
+With `AGENT_JOBQUEUE` and `AGENT_WORKERS` set, `webapp.py` starts the
+supervisor alongside the server instead of an in-process pool, so the mode is
+configured in the env file that `langgraph.json` points at:
+
+    AGENT_WORKERS          worker processes (default: usable CPUs)
+    AGENT_WORKER_PIN       pin worker i to the i-th usable CPU (default 1)
+    AGENT_WORKER_NICE      niceness added to workers, so the server's
+                           interactive runs get the CPU first (default 10)
+    AGENT_WORKER_GRACE_S   time a stopping worker gets to finish (default 30)
+
+Workers pause dequeueing while the server runs `AGENT_JOBQUEUE_YIELD_INFLIGHT`
+interactive model calls, which the server reports through the queue database
+(see `agent.jobqueue`).
+
+SIGHUP (or `POST /workers/restart`) restarts workers one at a time. Each
+replacement starts before the old worker is told to drain, so capacity never
+drops. SIGTERM drains every worker and exits. Crashed workers are restarted.
+
+State shared across processes: point `AGENT_CACHE_REDIS_URL` at a local Redis
+sidecar for the response cache and `AGENT_RATELIMIT_REDIS_URL` for the token
+buckets (see `agent.ratelimit`). Without one, every process that calls the
+model takes an equal share of each rate and concurrency limit. Started by
+`webapp.py`, that is the server (for interactive runs) and the workers, so
+each gets `1/(AGENT_WORKERS + 1)`. Run standalone, each worker gets
+`1/AGENT_WORKERS`.
+"""
+
+from __future__ import annotations
+
+import argparse
+import asyncio
+import logging
+import os
+import signal
+import subprocess
+import sys
+import time
+from typing import Any, Dict, List, Optional
+
+from agent import jobqueue, resources, warmup
+
+logger = logging.getLogger(__name__)
+
+
+def usable_cpus() -> List[int]:
+    """CPUs this process may run on (respects container cpusets)."""
+    if hasattr(os, "sched_getaffinity"):
+        return sorted(os.sched_getaffinity(0))
+    return list(range(os.cpu_count() or 1))
+
+
+def worker_count() -> int:
+    """`AGENT_WORKERS`, defaulting to the number of usable CPUs."""
+    return int(os.environ.get("AGENT_WORKERS") or len(usable_cpus()))
+
+
+class Supervisor:
+    """Keep `count` worker processes running; restart them on demand."""
+
+    def __init__(
+        self,
+        count: int,
+        *,
+        pin: bool = True,
+        grace: float = 30,
+        shares: Optional[int] = None,
+    ) -> None:
+        """Configure `count` workers, optionally pinned one per CPU.
+
+        `shares` is the number of processes splitting each unshared limit
+        (default `count`); it includes the server when it also calls the model.
+        """
+        self.count = count
+        self.pin = pin
+        self.grace = grace
+        self.shares = shares or count
+        self.cpus = usable_cpus()
+        self.procs: Dict[int, subprocess.Popen[bytes]] = {}
+        self._restart = False
+        self._stopping = False
+
+    def _spawn(self, index: int) -> subprocess.Popen[bytes]:
+        env = {
+            **os.environ,
+            "AGENT_WORKER_INDEX": str(index),
+            "AGENT_WORKER_COUNT": str(self.shares),
+        }
+        if self.pin:
+            env["AGENT_WORKER_CPU"] = str(self.cpus[index % len(self.cpus)])
+        command = [sys.executable, "-m", "agent.workers", "--child"]
+        return subprocess.Popen(command, env=env)
+
+    def _drain(self, proc: subprocess.Popen[bytes]) -> None:
+        proc.terminate()
+        try:
+            proc.wait(self.grace + 5)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            proc.wait()
+
+    def rolling_restart(self) -> None:
+        """Replace every worker, one at a time."""
+        for index in range(self.count):
+            old = self.procs[index]
+            self.procs[index] = self._spawn(index)
+            self._drain(old)
+
+    def _on_signal(self, signum: int, frame: Any) -> None:
+        if signum == signal.SIGHUP:
+            self._restart = True
+        else:
+            self._stopping = True
+
+    def run(self) -> None:
+        """Supervise until SIGTERM/SIGINT."""
+        for signum in (signal.SIGHUP, signal.SIGTERM, signal.SIGINT):
+            signal.signal(signum, self._on_signal)
+        self.procs = {i: self._spawn(i) for i in range(self.count)}
+        while not self._stopping:
+            if self._restart:
+                self._restart = False
+                self.rolling_restart()
+            for index, proc in self.procs.items():
+                if proc.poll() is not None:
+                    logger.warning("worker %d exited with %s", index, proc.returncode)
+                    self.procs[index] = self._spawn(index)
+            time.sleep(0.5)
+        for proc in self.procs.values():
+            proc.terminate()
+        for proc in self.procs.values():
+            self._drain(proc)
+
+
+async def _run_child() -> None:
+    cpu = os.environ.get("AGENT_WORKER_CPU")
+    if cpu is not None and hasattr(os, "sched_setaffinity"):
+        os.sched_setaffinity(0, {int(cpu)})
+    os.nice(int(os.environ.get("AGENT_WORKER_NICE", 10)))
+    pool = jobqueue.make_pool(jobqueue.JobQueue.from_uri(os.environ["AGENT_JOBQUEUE"]))
+    stop = asyncio.Event()
+    loop = asyncio.get_running_loop()
+    for signum in (signal.SIGTERM, signal.SIGINT):
+        loop.add_signal_handler(signum, stop.set)
+    warmup.install()
+    await resources.startup()
+    pool.start()
+    await stop.wait()
+    await pool.stop(grace=float(os.environ.get("AGENT_WORKER_GRACE_S", 30)))
+    await resources.shutdown()
+
+
+_supervisor: Optional[subprocess.Popen[bytes]] = None
+
+
+def install() -> None:
+    """Run the supervisor as a child of the server for its whole lifetime.
+
+    The server keeps serving interactive runs, so it counts as one more
+    process in the split of unshared limits.
+    """
+    count = worker_count()
+    shares = count + 1
+    # Read by `agent.ratelimit` when this process first builds a limiter.
+    os.environ["AGENT_WORKER_COUNT"] = str(shares)
+    command = [sys.executable, "-m", "agent.workers"]
+    command += ["--workers", str(count), "--shares", str(shares)]
+
+    @resources.on_startup
+    async def _start() -> None:
+        global _supervisor
+        _supervisor = subprocess.Popen(command)
+
+    @resources.on_shutdown
+    async def _stop() -> None:
+        if _supervisor is not None:
+            _supervisor.terminate()
+            await asyncio.to_thread(_supervisor.wait)
+
+
+def restart() -> bool:
+    """Ask the supervisor started by `install` for a rolling restart."""
+    if _supervisor is None or _supervisor.poll() is not None:
+        return False
+    _supervisor.send_signal(signal.SIGHUP)
+    return True
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--child", action="store_true", help=argparse.SUPPRESS)
+    parser.add_argument("--workers", type=int, default=None)
+    parser.add_argument(
+        "--shares",
+        type=int,
+        default=None,
+        help="processes splitting each limit (default: --workers)",
+    )
+    args = parser.parse_args()
+    logging.basicConfig(level=logging.INFO)
+    if args.child:
+        asyncio.run(_run_child())
+    else:
+        count = args.workers or worker_count()
+        pin = os.environ.get("AGENT_WORKER_PIN", "1") not in ("0", "false", "False")
+        grace = float(os.environ.get("AGENT_WORKER_GRACE_S", 30))
+        Supervisor(count, pin=pin, grace=grace, shares=args.shares).run()
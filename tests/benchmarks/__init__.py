@@ -0,0 +1 @@
+"""Benchmarks for the compiled graph. Run with `make bench`."""
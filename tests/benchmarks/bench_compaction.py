@@ -0,0 +1,87 @@
+"""Per-turn cost of a long-lived thread, with and without compaction.
+
+Runs thousands of turns on one thread against an in-memory checkpointer and
+reports step latency and checkpoint size as the thread ages. With compaction
+on, both should stay flat; without it they grow with the turn count.
+
+    python -m tests.benchmarks.bench_compaction --turns 2000
+"""
+
+from __future__ import annotations
+
+import argparse
+import asyncio
+import json
+import time
+from typing import Any, Dict, List
+
+from langgraph.checkpoint.memory import InMemorySaver
+from langgraph.graph import StateGraph
+from langgraph.store.memory import InMemoryStore
+
+from agent.graph import Context, State, call_model, compact
+from agent.serde import CompactSerializer
+
+
+async def run(turns: int, every: int, budget: int) -> List[Dict[str, Any]]:
+    """Measure both modes, sampling every `every` turns."""
+    serde = CompactSerializer()
+    results = []
+    for mode, context in (
+        ("append-only", {}),
+        ("compacted", {"history_max_bytes": budget}),
+    ):
+        graph = (
+            StateGraph(State, context_schema=Context)
+            .add_node(call_model)
+            .add_node(compact)
+            .add_edge("__start__", "call_model")
+            .add_edge("call_model", "compact")
+            .compile(checkpointer=InMemorySaver(), store=InMemoryStore())
+        )
+        config: Dict[str, Any] = {"configurable": {"thread_id": mode}}
+        window: List[float] = []
+        for turn in range(1, turns + 1):
+            start = time.perf_counter()
+            await graph.ainvoke(
+                {"changeme": f"turn {turn} " * 20}, config, context=context
+            )
+            window.append(time.perf_counter() - start)
+            if turn % every == 0:
+                snapshot = await graph.aget_state(config)
+                # Checkpointers store one serialized value per channel.
+                state_bytes = sum(
+                    len(serde.dumps_typed(value)[1])
+                    for value in snapshot.values.values()
+                )
+                results.append(
+                    {
+                        "mode": mode,
+                        "turn": turn,
+                        "step_ms": sum(window) / len(window) * 1000,
+                        "state_bytes": state_bytes,
+                    }
+                )
+                window.clear()
+    return results
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--turns", type=int, default=2000)
+    parser.add_argument("--every", type=int, default=250)
+    parser.add_argument("--budget", type=int, default=16_384, help="history bytes")
+    parser.add_argument("--json", action="store_true", help="emit JSON lines")
+    args = parser.parse_args()
+    results = asyncio.run(run(args.turns, args.every, args.budget))
+    if args.json:
+        for r in results:
+            print(json.dumps(r))  # noqa: T201
+    else:
+        header = f"{'mode':>12} {'turn':>7} {'step ms':>9} {'state bytes':>12}"
+        print(header)  # noqa: T201
+        for r in results:
+            print(  # noqa: T201
+                f"{r['mode']:>12} {r['turn']:>7} {r['step_ms']:>9.3f} "
+                f"{r['state_bytes']:>12}"
+            )
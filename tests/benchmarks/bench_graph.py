@@ -0,0 +1,129 @@
+"""Latency/throughput benchmark for `agent.graph`.
+
+Drives `graph.ainvoke` at fixed concurrency levels and reports latency
+percentiles, invocations/sec and peak RSS for each level.
+
+    python -m tests.benchmarks.bench_graph --concurrency 1 16 256 1024
+"""
+
+from __future__ import annotations
+
+import argparse
+import asyncio
+import json
+import resource
+import statistics
+import sys
+import time
+import uuid
+from typing import Any, Dict, List
+
+from agent import resources
+from agent.graph import graph
+from agent.persistence import DURABILITY
+
+DEFAULT_CONCURRENCY = [1, 16, 256, 1024]
+
+
+def percentile(samples: List[float], pct: float) -> float:
+    """Return the nearest-rank percentile of `samples`."""
+    if not samples:
+        return 0.0
+    ordered = sorted(samples)
+    rank = max(0, min(len(ordered) - 1, round(pct / 100 * len(ordered)) - 1))
+    return ordered[rank]
+
+
+def peak_rss_mb() -> float:
+    """Return the peak resident set size of this process in MiB."""
+    peak = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    # ru_maxrss is reported in bytes on macOS and in KiB elsewhere.
+    return peak / (1024 * 1024) if sys.platform == "darwin" else peak / 1024
+
+
+async def run_level(concurrency: int, calls_per_worker: int) -> Dict[str, Any]:
+    """Keep `concurrency` invocations in flight and collect per-call latency."""
+    latencies: List[float] = []
+    inputs = {"changeme": "bench"}
+    context = {"my_configurable_param": "bench"}
+
+    async def worker() -> None:
+        for _ in range(calls_per_worker):
+            # A fresh thread per call, in case AGENT_CHECKPOINTER is set.
+            config = {"configurable": {"thread_id": str(uuid.uuid4())}}
+            start = time.perf_counter()
+            await graph.ainvoke(
+                inputs, config, context=context, durability=DURABILITY
+            )
+            latencies.append(time.perf_counter() - start)
+
+    start = time.perf_counter()
+    await asyncio.gather(*(worker() for _ in range(concurrency)))
+    elapsed = time.perf_counter() - start
+
+    return {
+        "concurrency": concurrency,
+        "invocations": len(latencies),
+        "p50_ms": percentile(latencies, 50) * 1000,
+        "p95_ms": percentile(latencies, 95) * 1000,
+        "p99_ms": percentile(latencies, 99) * 1000,
+        "mean_ms": statistics.fmean(latencies) * 1000,
+        "invocations_per_sec": len(latencies) / elapsed,
+        "peak_rss_mb": peak_rss_mb(),
+    }
+
+
+async def main(args: argparse.Namespace) -> List[Dict[str, Any]]:
+    """Run a warm-up pass followed by every requested concurrency level."""
+    await resources.startup()
+    try:
+        await run_level(1, args.warmup)
+        results = []
+        for concurrency in args.concurrency:
+            # Keep the total number of calls per level roughly constant so high
+            # concurrency levels don't take orders of magnitude longer.
+            calls = max(1, args.invocations // concurrency)
+            results.append(await run_level(concurrency, calls))
+        return results
+    finally:
+        await resources.shutdown()
+
+
+def format_table(results: List[Dict[str, Any]]) -> str:
+    """Render results as a fixed-width table."""
+    header = f"{'conc':>6} {'calls':>7} {'p50 ms':>9} {'p95 ms':>9} {'p99 ms':>9} {'inv/s':>10} {'rss MiB':>9}"
+    rows = [header, "-" * len(header)]
+    for r in results:
+        rows.append(
+            f"{r['concurrency']:>6} {r['invocations']:>7} {r['p50_ms']:>9.3f} "
+            f"{r['p95_ms']:>9.3f} {r['p99_ms']:>9.3f} "
+            f"{r['invocations_per_sec']:>10.1f} {r['peak_rss_mb']:>9.1f}"
+        )
+    return "\n".join(rows)
+
+
+def parse_args(argv: List[str] | None = None) -> argparse.Namespace:
+    """Parse command-line options."""
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument(
+        "--concurrency", type=int, nargs="+", default=DEFAULT_CONCURRENCY
+    )
+    parser.add_argument(
+        "--invocations",
+        type=int,
+        default=4096,
+        help="approximate number of calls per concurrency level",
+    )
+    parser.add_argument("--warmup", type=int, default=50)
+    parser.add_argument("--json", action="store_true", help="emit JSON lines")
+    return parser.parse_args(argv)
+
+
+if __name__ == "__main__":
+    args = parse_args()
+    results = asyncio.run(main(args))
+    if args.json:
+        for r in results:
+            print(json.dumps(r))  # noqa: T201
+    else:
+        print(format_table(results))  # noqa: T201
@@ -0,0 +1,79 @@
+"""Production image size and container start-to-ready time.
+
+Builds the image with `langgraph build`, reports its size, then starts it and
+times how long the server takes to answer `/ok`. The standalone server needs
+Redis and Postgres; pass their URIs (and any secrets) through `--env-file`.
+
+    python -m tests.benchmarks.bench_image --env-file .env.bench
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import subprocess
+import time
+import urllib.error
+import urllib.request
+from typing import Dict, Optional
+
+
+def build(tag: str) -> None:
+    """Build the image from `langgraph.json`."""
+    subprocess.run(["langgraph", "build", "-t", tag], check=True)
+
+
+def image_size_mb(tag: str) -> float:
+    """Return the uncompressed image size in MiB."""
+    out = subprocess.run(
+        ["docker", "image", "inspect", "--format", "{{.Size}}", tag],
+        check=True,
+        capture_output=True,
+        text=True,
+    ).stdout
+    return int(out.strip()) / (1024 * 1024)
+
+
+def start_to_ready_s(
+    tag: str, port: int, env_file: Optional[str], timeout: float
+) -> float:
+    """Start a container and return the seconds until `/ok` answers 200."""
+    cmd = ["docker", "run", "-d", "--rm", "-p", f"{port}:8000"]
+    if env_file:
+        cmd += ["--env-file", env_file]
+    start = time.perf_counter()
+    container = subprocess.run(
+        [*cmd, tag], check=True, capture_output=True, text=True
+    ).stdout.strip()
+    try:
+        while time.perf_counter() - start < timeout:
+            try:
+                with urllib.request.urlopen(f"http://localhost:{port}/ok", timeout=1):
+                    return time.perf_counter() - start
+            except (urllib.error.URLError, ConnectionError):
+                time.sleep(0.1)
+        raise TimeoutError(f"server not ready after {timeout}s")
+    finally:
+        subprocess.run(["docker", "stop", container], capture_output=True)
+
+
+def run(args: argparse.Namespace) -> Dict[str, float]:
+    """Build (unless skipped) and measure the image."""
+    if not args.skip_build:
+        build(args.tag)
+    return {
+        "image_size_mb": image_size_mb(args.tag),
+        "start_to_ready_s": start_to_ready_s(
+            args.tag, args.port, args.env_file, args.timeout
+        ),
+    }
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--tag", default="agent:bench")
+    parser.add_argument("--port", type=int, default=8123)
+    parser.add_argument("--env-file")
+    parser.add_argument("--timeout", type=float, default=120)
+    parser.add_argument("--skip-build", action="store_true")
+    print(json.dumps(run(parser.parse_args())))  # noqa: T201
@@ -0,0 +1,123 @@
+"""Encode/decode cost and size of checkpointed channel values across serializers.
+
+Checkpointers serialize each channel value separately, so each codec here
+encodes the `agent` graph's channels (`changeme`, `history`, `turns`,
+`metadata`) one by one, as `put` does. Compares a plain JSON baseline,
+LangGraph's default checkpoint serializer and `agent.serde.CompactSerializer`
+for a few payload sizes, plus the compact serializer with the payload moved
+out to `agent.blobs` (the one-time upload isn't counted).
+
+    python -m tests.benchmarks.bench_serde
+"""
+
+from __future__ import annotations
+
+import argparse
+import hashlib
+import json
+import time
+from typing import Any, Callable, Dict, List, Tuple
+
+from langgraph.checkpoint.serde.jsonplus import JsonPlusSerializer
+
+from agent.blobs import BlobRef
+from agent.serde import CompactSerializer
+
+PAYLOAD_SIZES = [100, 10_000, 1_000_000]
+
+Channels = Dict[str, Any]
+Codec = Tuple[Callable[[Channels], Any], Callable[[Any], Any]]
+
+
+def _json_codec() -> Codec:
+    def encode(values: Channels) -> Dict[str, bytes]:
+        return {k: json.dumps(v).encode() for k, v in values.items()}
+
+    def decode(encoded: Dict[str, bytes]) -> Channels:
+        return {k: json.loads(v) for k, v in encoded.items()}
+
+    return encode, decode
+
+
+def _serde_codec(serde: Any) -> Codec:
+    def encode(values: Channels) -> Dict[str, Tuple[str, bytes]]:
+        return {k: serde.dumps_typed(v) for k, v in values.items()}
+
+    def decode(encoded: Dict[str, Tuple[str, bytes]]) -> Channels:
+        return {k: serde.loads_typed(v) for k, v in encoded.items()}
+
+    return encode, decode
+
+
+def _size(encoded: Dict[str, Any]) -> int:
+    return sum(len(v[1] if isinstance(v, tuple) else v) for v in encoded.values())
+
+
+def _channels(changeme: str, history: List[str]) -> Channels:
+    return {
+        "changeme": changeme,
+        "history": history,
+        "turns": len(history),
+        "metadata": {"outcome": "ok"},
+    }
+
+
+def _time_per_call(fn: Callable[[], Any], repeat: int) -> float:
+    start = time.perf_counter()
+    for _ in range(repeat):
+        fn()
+    return (time.perf_counter() - start) / repeat
+
+
+def run(repeat: int) -> List[Dict[str, Any]]:
+    """Measure every codec at every payload size."""
+    codecs = {
+        "json": _json_codec(),
+        "jsonplus": _serde_codec(JsonPlusSerializer()),
+        "compact": _serde_codec(CompactSerializer()),
+    }
+    results = []
+    for size in PAYLOAD_SIZES:
+        # Word-like text, so compression ratios are closer to real prose than
+        # a single repeated character would give.
+        words = "the quick brown fox jumps over a lazy dog ".split()
+        count = size // 5 + 1
+        text = " ".join(words[i % len(words)] + str(i % 97) for i in range(count))
+        history = [text[i : i + 200] for i in range(0, min(size, 20_000), 200)]
+        values = _channels(text[:size], history)
+        digest = hashlib.sha256(text[:size].encode()).hexdigest()
+        by_ref = _channels(str(BlobRef.for_digest(digest, size)), history)
+        calls = max(3, repeat * 1000 // max(1, size // 100))
+        runs = [(name, codec, values) for name, codec in codecs.items()]
+        runs.append(("blobref", codecs["compact"], by_ref))
+        for name, (encode, decode), payload in runs:
+            encoded = encode(payload)
+            results.append(
+                {
+                    "codec": name,
+                    "payload_chars": size,
+                    "bytes": _size(encoded),
+                    "encode_us": _time_per_call(lambda: encode(payload), calls) * 1e6,
+                    "decode_us": _time_per_call(lambda: decode(encoded), calls) * 1e6,
+                }
+            )
+    return results
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--repeat", type=int, default=10)
+    parser.add_argument("--json", action="store_true", help="emit JSON lines")
+    args = parser.parse_args()
+    results = run(args.repeat)
+    if args.json:
+        for r in results:
+            print(json.dumps(r))  # noqa: T201
+    else:
+        header = f"{'codec':>9} {'chars':>9} {'bytes':>9} {'enc us':>10} {'dec us':>10}"
+        print(header)  # noqa: T201
+        for r in results:
+            print(  # noqa: T201
+                f"{r['codec']:>9} {r['payload_chars']:>9} {r['bytes']:>9} "
+                f"{r['encode_us']:>10.2f} {r['decode_us']:>10.2f}"
+            )
@@ -0,0 +1,72 @@
+"""Cold-start benchmark: import time, graph compile time and first invoke.
+
+Each sample runs in a fresh interpreter, so module caches and lazily built
+graphs start cold, exactly as on a newly scheduled worker. `agent_modules`
+counts the `agent` submodules that importing `agent.graph` loads; the
+per-feature ones (batching, blobs, hedging, racing, ...) load on first use.
+
+    python -m tests.benchmarks.bench_startup --runs 5
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import statistics
+import subprocess
+import sys
+import time
+from typing import Dict, List
+
+# Runs inside the child interpreter and prints one JSON object of timings.
+_PROBE = """
+import asyncio, importlib, json, sys, time
+t0 = time.perf_counter()
+import agent
+t1 = time.perf_counter()
+importlib.import_module("agent.graph")
+t2 = time.perf_counter()
+agent_modules = sum(name.startswith("agent.") for name in sys.modules)
+from agent.graph import graph
+t3 = time.perf_counter()
+asyncio.run(graph.ainvoke({"changeme": "startup"}))
+t4 = time.perf_counter()
+print(json.dumps({
+    "import_package_ms": (t1 - t0) * 1000,
+    "import_graph_module_ms": (t2 - t1) * 1000,
+    "compile_graph_ms": (t3 - t2) * 1000,
+    "first_invoke_ms": (t4 - t3) * 1000,
+    "agent_modules": agent_modules,
+}))
+"""
+
+
+def sample() -> Dict[str, float]:
+    """Measure one cold start in a fresh interpreter."""
+    start = time.perf_counter()
+    out = subprocess.run(
+        [sys.executable, "-c", _PROBE], check=True, capture_output=True, text=True
+    ).stdout
+    total = (time.perf_counter() - start) * 1000
+    timings: Dict[str, float] = json.loads(out.strip().splitlines()[-1])
+    timings["process_total_ms"] = total
+    return timings
+
+
+def run(runs: int) -> Dict[str, float]:
+    """Return the median of each timing over `runs` cold starts."""
+    samples: List[Dict[str, float]] = [sample() for _ in range(runs)]
+    return {k: statistics.median(s[k] for s in samples) for k in samples[0]}
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--runs", type=int, default=5)
+    parser.add_argument("--json", action="store_true", help="emit JSON")
+    args = parser.parse_args()
+    result = run(args.runs)
+    if args.json:
+        print(json.dumps(result))  # noqa: T201
+    else:
+        for name, value in result.items():
+            print(f"{name:>24} {value:>10.1f}")  # noqa: T201
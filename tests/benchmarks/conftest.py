@@ -0,0 +1,89 @@
+"""Performance regression gate.
+
+Metrics are recorded relative to a fixed pure-Python calibration workload, so
+a baseline taken on one machine remains meaningful on a faster or slower one.
+
+    make perf-baseline    # measure and write perf_baseline.json
+    make perf-gate        # fail if a metric is worse than baseline by more
+                          # than PERF_THRESHOLD (default 0.25 = 25%)
+
+A metric with no baseline is skipped, or fails with `--perf-require-baseline`.
+Timings only compare within one environment, so no baseline is committed: CI
+measures the base commit of a pull request on the same runner, and publishes
+the baseline of each push to main as the `perf-baseline` artifact. The
+options are registered in tests/conftest.py.
+"""
+
+import json
+import time
+from pathlib import Path
+from typing import Any, Dict, Iterator
+
+import pytest
+
+BASELINE = Path(__file__).with_name("perf_baseline.json")
+
+
+def _calibrate() -> float:
+    def workload() -> None:
+        total = 0
+        for i in range(200_000):
+            total += i % 7
+        json.dumps([{"k": i, "v": str(i)} for i in range(2_000)])
+
+    best = float("inf")
+    for _ in range(5):
+        start = time.perf_counter()
+        workload()
+        best = min(best, time.perf_counter() - start)
+    return best
+
+
+class PerfGate:
+    def __init__(
+        self, update: bool, threshold: float, *, require_baseline: bool = False
+    ) -> None:
+        self.update = update
+        self.threshold = threshold
+        self.require_baseline = require_baseline
+        self.unit = _calibrate()
+        stored = json.loads(BASELINE.read_text()) if BASELINE.exists() else {}
+        self.baseline: Dict[str, float] = stored.get("metrics", {})
+        self.measured: Dict[str, float] = {}
+
+    def check(self, name: str, value: float, *, scale_with_cpu: bool = True) -> None:
+        """Compare `value` (lower is better) against the stored baseline."""
+        normalized = value / self.unit if scale_with_cpu else value
+        self.measured[name] = normalized
+        if self.update:
+            return
+        if name not in self.baseline:
+            message = f"no baseline for {name}; run `make perf-baseline`"
+            if self.require_baseline:
+                pytest.fail(message)
+            pytest.skip(message)
+        limit = self.baseline[name] * (1 + self.threshold)
+        assert normalized <= limit, (
+            f"{name} regressed: {normalized:.4g} vs baseline "
+            f"{self.baseline[name]:.4g} (limit {limit:.4g})"
+        )
+
+    def save(self) -> None:
+        metrics = {**self.baseline, **self.measured}
+        BASELINE.write_text(
+            json.dumps({"metrics": metrics}, indent=2, sort_keys=True) + "\n"
+        )
+
+
+@pytest.fixture(scope="session")
+def perf(request: Any) -> Iterator[PerfGate]:
+    option = request.config.getoption
+    gate = PerfGate(
+        option("--perf-update", False),
+        option("--perf-threshold", 0.25),
+        require_baseline=option("--perf-require-baseline", False),
+    )
+    yield gate
+    if gate.update:
+        gate.save()
+
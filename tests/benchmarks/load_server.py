@@ -0,0 +1,188 @@
+"""Load generator for a running LangGraph server (`langgraph dev` or an image).
+
+Replays an open-loop traffic profile against the server started from
+`langgraph.json`. Arrivals are scheduled ahead of time from a seeded RNG, so
+the same arguments always produce the same traffic. The request mix covers
+thread creation plus blocking (`wait`), streaming (`stream`) and background
+(`background`) runs.
+
+    python -m tests.benchmarks.load_server --profile steady --rate 20 --duration 60
+    python -m tests.benchmarks.load_server --profile replay --trace traffic.jsonl
+
+Prints one JSON document (throughput, error rate, queue depth, latency
+percentiles per request kind) so results can be diffed across releases.
+Trace files hold one `{"t": <offset s>, "kind": ..., "input": {...}}` per line.
+"""
+
+from __future__ import annotations
+
+import argparse
+import asyncio
+import json
+import random
+import time
+from collections import defaultdict
+from typing import Any, Dict, List, Set, Tuple
+
+from langgraph_sdk import get_client
+
+from tests.benchmarks.bench_graph import percentile
+
+KINDS = ("wait", "stream", "background")
+
+Arrival = Tuple[float, str, Dict[str, Any]]
+
+
+def _rate_at(args: argparse.Namespace, t: float) -> float:
+    if args.profile == "ramp":
+        return args.rate + (args.peak_rate - args.rate) * t / args.duration
+    if args.profile == "burst":
+        in_burst = (t % args.burst_every) < args.burst_length
+        return args.peak_rate if in_burst else args.rate
+    return args.rate
+
+
+def build_arrivals(args: argparse.Namespace) -> List[Arrival]:
+    """Return (offset, kind, input) arrivals for the selected profile."""
+    if args.profile == "replay":
+        with open(args.trace) as f:
+            rows = [json.loads(line) for line in f if line.strip()]
+        return [
+            (float(r["t"]), r.get("kind", "wait"), r.get("input", {})) for r in rows
+        ]
+    rng = random.Random(args.seed)
+    mix = [float(w) for w in args.mix.split(",")]
+    arrivals: List[Arrival] = []
+    t = 0.0
+    while True:
+        # Poisson arrivals; thinning against the peak handles varying rates.
+        peak = max(args.rate, args.peak_rate)
+        t += rng.expovariate(peak)
+        if t >= args.duration:
+            return arrivals
+        if rng.random() * peak > _rate_at(args, t):
+            continue
+        kind = rng.choices(KINDS, weights=mix)[0]
+        arrivals.append((t, kind, {"changeme": f"load-{len(arrivals)}"}))
+
+
+class LoadRun:
+    """Drive arrivals against the server and collect measurements."""
+
+    def __init__(self, args: argparse.Namespace) -> None:
+        """Connect to the server at `args.url`."""
+        self.args = args
+        self.client = get_client(url=args.url)
+        self.latencies: Dict[str, List[float]] = defaultdict(list)
+        self.errors: Dict[str, int] = defaultdict(int)
+        self.pending_background: Set[Tuple[str, str]] = set()
+        self.queue_depth: List[int] = []
+
+    async def one(self, kind: str, payload: Dict[str, Any]) -> None:
+        """Create a thread and run one request of `kind` on it."""
+        start = time.perf_counter()
+        assistant = self.args.assistant
+        try:
+            thread = await self.client.threads.create()
+            thread_id = thread["thread_id"]
+            if kind == "wait":
+                await self.client.runs.wait(thread_id, assistant, input=payload)
+            elif kind == "stream":
+                first = None
+                async for _ in self.client.runs.stream(
+                    thread_id, assistant, input=payload, stream_mode="values"
+                ):
+                    first = first or time.perf_counter()
+                if first is not None:
+                    self.latencies["stream_first_event"].append(first - start)
+            else:
+                run = await self.client.runs.create(thread_id, assistant, input=payload)
+                self.pending_background.add((thread_id, run["run_id"]))
+                await self.client.runs.join(thread_id, run["run_id"])
+                self.pending_background.discard((thread_id, run["run_id"]))
+        except Exception:
+            self.errors[kind] += 1
+            return
+        self.latencies[kind].append(time.perf_counter() - start)
+
+    async def sample_queue_depth(self) -> None:
+        """Periodically count our background runs the server hasn't started."""
+        while True:
+            await asyncio.sleep(self.args.sample_every)
+            runs = list(self.pending_background)
+            statuses = await asyncio.gather(
+                *(self.client.runs.get(t, r) for t, r in runs),
+                return_exceptions=True,
+            )
+            pending = [s for s in statuses if isinstance(s, dict)]
+            self.queue_depth.append(
+                sum(1 for s in pending if s["status"] == "pending")
+            )
+
+    async def run(self, arrivals: List[Arrival]) -> Dict[str, Any]:
+        """Replay `arrivals` on schedule and summarize."""
+        sampler = asyncio.create_task(self.sample_queue_depth())
+        tasks = []
+        start = time.perf_counter()
+        for offset, kind, payload in arrivals:
+            delay = offset - (time.perf_counter() - start)
+            if delay > 0:
+                await asyncio.sleep(delay)
+            tasks.append(asyncio.create_task(self.one(kind, payload)))
+        await asyncio.gather(*tasks)
+        elapsed = time.perf_counter() - start
+        sampler.cancel()
+        return self.summary(len(arrivals), elapsed)
+
+    def summary(self, issued: int, elapsed: float) -> Dict[str, Any]:
+        """Build the machine-readable report."""
+        completed = sum(len(v) for k, v in self.latencies.items() if k in KINDS)
+        failed = sum(self.errors.values())
+        return {
+            "profile": self.args.profile,
+            "issued": issued,
+            "completed": completed,
+            "throughput_rps": completed / elapsed if elapsed else 0.0,
+            "error_rate": failed / issued if issued else 0.0,
+            "errors": dict(self.errors),
+            "queue_depth_max": max(self.queue_depth, default=0),
+            "queue_depth_mean": (
+                sum(self.queue_depth) / len(self.queue_depth) if self.queue_depth else 0
+            ),
+            "latency_ms": {
+                kind: {
+                    f"p{p}": percentile(samples, p) * 1000 for p in (50, 95, 99)
+                }
+                for kind, samples in self.latencies.items()
+            },
+        }
+
+
+def parse_args() -> argparse.Namespace:
+    """Parse command-line options."""
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--url", default="http://localhost:2024")
+    parser.add_argument("--assistant", default="agent")
+    parser.add_argument(
+        "--profile", choices=["steady", "burst", "ramp", "replay"], default="steady"
+    )
+    parser.add_argument("--rate", type=float, default=10, help="base requests/sec")
+    parser.add_argument(
+        "--peak-rate", type=float, default=50, help="burst/ramp-end requests/sec"
+    )
+    parser.add_argument("--duration", type=float, default=30, help="seconds")
+    parser.add_argument("--burst-every", type=float, default=10)
+    parser.add_argument("--burst-length", type=float, default=2)
+    parser.add_argument(
+        "--mix", default="6,3,1", help="weights for wait,stream,background"
+    )
+    parser.add_argument("--trace", help="JSONL trace for --profile replay")
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--sample-every", type=float, default=1.0)
+    return parser.parse_args()
+
+
+if __name__ == "__main__":
+    args = parse_args()
+    report = asyncio.run(LoadRun(args).run(build_arrivals(args)))
+    print(json.dumps(report, indent=2))  # noqa: T201
@@ -0,0 +1,103 @@
+"""Microbenchmarks checked against `perf_baseline.json`; see conftest.py."""
+
+import asyncio
+import importlib
+import time
+import tracemalloc
+from typing import Any, Callable
+
+import pytest
+
+from agent.serde import CompactSerializer
+
+pytestmark = pytest.mark.anyio
+
+graph_module = importlib.import_module("agent.graph")
+
+
+def best_of(fn: Callable[[], Any], repeat: int = 5) -> float:
+    best = float("inf")
+    for _ in range(repeat):
+        start = time.perf_counter()
+        fn()
+        best = min(best, time.perf_counter() - start)
+    return best
+
+
+def _graph_with(monkeypatch: pytest.MonkeyPatch, node: Any) -> Any:
+    # Same topology and wrappers as production, minus the model call.
+    monkeypatch.setattr(graph_module, "call_model", node)
+    return graph_module.build_graph()
+
+
+def test_compile_time(perf: Any) -> None:
+    perf.check("compile_s", best_of(graph_module.build_graph))
+
+
+async def test_invoke_overhead(perf: Any, monkeypatch: pytest.MonkeyPatch) -> None:
+    async def call_model(state: Any, runtime: Any) -> Any:
+        return {"turns": 1}
+
+    graph = _graph_with(monkeypatch, call_model)
+    await graph.ainvoke({"changeme": "warm-up"})
+    calls = 200
+    best = float("inf")
+    for _ in range(3):
+        start = time.perf_counter()
+        for _ in range(calls):
+            await graph.ainvoke({"changeme": "x"})
+        best = min(best, time.perf_counter() - start)
+    perf.check("invoke_overhead_s", best / calls)
+
+
+def test_serialization_cost(perf: Any) -> None:
+    serde = CompactSerializer()
+    # Checkpointers serialize one value per channel, never the State itself.
+    channels = {
+        "changeme": "x" * 1000,
+        "history": [f"turn {i} " * 20 for i in range(100)],
+        "turns": 100,
+        "metadata": {"outcome": "ok"},
+    }
+
+    def round_trips() -> None:
+        for _ in range(100):
+            for value in channels.values():
+                serde.loads_typed(serde.dumps_typed(value))
+
+    perf.check("serde_round_trip_s", best_of(round_trips) / 100)
+
+
+async def test_memory_per_inflight_run(
+    perf: Any, monkeypatch: pytest.MonkeyPatch
+) -> None:
+    release = asyncio.Event()
+    arrived = 0
+
+    async def call_model(state: Any, runtime: Any) -> Any:
+        nonlocal arrived
+        arrived += 1
+        await release.wait()
+        return {"turns": 1}
+
+    graph = _graph_with(monkeypatch, call_model)
+    release.set()
+    await graph.ainvoke({"changeme": "warm-up"})
+    release.clear()
+    runs = 500
+    arrived = 0
+    tracemalloc.start()
+    try:
+        before = tracemalloc.get_traced_memory()[0]
+        tasks = [
+            asyncio.create_task(graph.ainvoke({"changeme": "x"})) for _ in range(runs)
+        ]
+        while arrived < runs:
+            await asyncio.sleep(0.01)
+        during = tracemalloc.get_traced_memory()[0]
+        release.set()
+        await asyncio.gather(*tasks)
+    finally:
+        tracemalloc.stop()
+    per_run = (during - before) / runs
+    perf.check("memory_per_inflight_run_bytes", per_run, scale_with_cpu=False)
@@ -1,6 +1,28 @@
+from typing import Any
+
 import pytest
 
 
+def pytest_addoption(parser: Any) -> None:
+    # Options for tests/benchmarks/test_perf_gate.py. Registered here so they
+    # exist however pytest is invoked; see tests/benchmarks/conftest.py.
+    group = parser.getgroup("perf")
+    group.addoption(
+        "--perf-update", action="store_true", help="rewrite perf_baseline.json"
+    )
+    group.addoption(
+        "--perf-threshold",
+        type=float,
+        default=0.25,
+        help="allowed regression as a fraction of the baseline",
+    )
+    group.addoption(
+        "--perf-require-baseline",
+        action="store_true",
+        help="fail, rather than skip, a metric with no baseline",
+    )
+
+
 @pytest.fixture(scope="session")
 def anyio_backend():
     return "asyncio"
@@ -1,6 +1,6 @@
 import pytest
 
-from agent import graph
+from agent.graph import graph
 
 pytestmark = pytest.mark.anyio
 
@@ -10,3 +10,17 @@ async def test_agent_simple_passthrough() -> None:
     inputs = {"changeme": "some_val"}
     res = await graph.ainvoke(inputs)
     assert res is not None
+
+
+@pytest.mark.langsmith
+async def test_agent_streams_chunks_before_final_state() -> None:
+    inputs = {"changeme": "some_val"}
+    context = {"my_configurable_param": "streaming", "stream": True}
+    modes = []
+    async for mode, _ in graph.astream(
+        inputs, context=context, stream_mode=["custom", "values"]
+    ):
+        modes.append(mode)
+    assert "custom" in modes
+    assert modes[-1] == "values"
+    assert modes.index("custom") < len(modes) - 1
@@ -0,0 +1,47 @@
+import pytest
+
+from agent.accounting import Latency, accumulate, ledger, split_call, usage_label
+from agent.graph import graph
+
+pytestmark = pytest.mark.anyio
+
+
+def test_split_call_uses_reported_generation_time() -> None:
+    assert split_call(Latency(), 0.5) == {"generation_s": 0.5}
+    split = split_call(Latency(generation_s=0.3), 0.5)
+    assert split["generation_s"] == 0.3
+    assert split["network_s"] == pytest.approx(0.2)
+
+
+def test_usage_label_prefers_context_then_assistant() -> None:
+    config = {"metadata": {"assistant_id": "asst-1"}}
+    assert usage_label({"usage_label": "team-a"}, config) == "team-a"
+    assert usage_label({}, config) == "asst-1"
+    assert usage_label({}, {}) == "default"
+
+
+def test_accumulate_counts_cached_runs() -> None:
+    total = accumulate(None, {"source": "model", "input_tokens": 10})
+    total = accumulate(total, {"source": "exact", "total_s": 0.1})
+    assert total == {"runs": 2, "cached_runs": 1, "input_tokens": 10, "total_s": 0.1}
+
+
+async def test_call_model_records_usage_per_label() -> None:
+    ledger.reset()
+    context = {
+        "my_configurable_param": "acct",
+        "usage_label": "acct-test",
+        "response_cache": True,
+    }
+    first = await graph.ainvoke({"changeme": "usage"}, context=context)
+    usage = first["metadata"]["usage"]
+    assert usage["source"] == "model"
+    assert usage["model"] == "default"
+    assert usage["output_tokens"] > 0
+    assert {"queue_s", "generation_s", "total_s"} <= usage.keys()
+    second = await graph.ainvoke({"changeme": "usage"}, context=context)
+    assert second["metadata"]["usage"]["source"] == "exact"
+    (row,) = [r for r in ledger.snapshot() if r["label"] == "acct-test"]
+    assert row["runs"] == 2
+    assert row["cached_runs"] == 1
+    assert row["output_tokens"] == usage["output_tokens"]
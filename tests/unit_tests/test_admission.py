@@ -0,0 +1,151 @@
+import asyncio
+from typing import Any, Dict, List
+
+import pytest
+
+from agent import admission
+from agent.admission import AdmissionController, Overloaded, Quotas
+from agent.graph import graph
+
+pytestmark = pytest.mark.anyio
+
+
+async def test_queue_sheds_when_full_and_after_waiting_too_long() -> None:
+    controller = AdmissionController(1, max_queue=1, max_queue_s=0.05)
+    async with controller.admit():
+        waiter = asyncio.ensure_future(controller.admit().__aenter__())
+        await asyncio.sleep(0)
+        with pytest.raises(Overloaded) as full:
+            await controller.admit().__aenter__()
+        assert (full.value.status, full.value.reason) == (429, "queue_full")
+        with pytest.raises(Overloaded) as late:
+            await waiter
+        assert (late.value.status, late.value.reason) == (503, "queue_time")
+        # Runs are timing out in the queue: refuse new ones up front.
+        overloaded = controller.overloaded()
+        assert overloaded is not None and overloaded.status == 503
+    assert controller.overloaded() is None
+    async with controller.admit():
+        assert controller.inflight == 1
+
+
+async def test_queue_time_shedding_expires_after_one_wait_limit() -> None:
+    controller = AdmissionController(1, max_queue=1, max_queue_s=0.05)
+    async with controller.admit():
+        with pytest.raises(Overloaded):
+            await controller.admit().__aenter__()
+        assert controller.overloaded() is not None
+        # Still at capacity, but the empty queue may take a run again.
+        await asyncio.sleep(0.06)
+        assert controller.overloaded() is None
+        waiter = asyncio.ensure_future(controller.admit().__aenter__())
+        await asyncio.sleep(0)
+    await waiter
+    assert controller.inflight == 1 and controller.queue_delay < 0.05
+
+
+async def test_released_slot_goes_to_the_oldest_waiter() -> None:
+    controller = AdmissionController(1, max_queue=2, max_queue_s=1.0)
+    order: List[int] = []
+
+    async def run(i: int) -> None:
+        async with controller.admit():
+            order.append(i)
+            await asyncio.sleep(0.01)
+
+    await asyncio.gather(*(run(i) for i in range(3)))
+    assert order == [0, 1, 2]
+    assert controller.inflight == 0 and controller.waiting == 0
+
+
+def test_quota_is_per_label() -> None:
+    quotas = Quotas()
+    with quotas.hold("a", 1):
+        with quotas.hold("b", 1):
+            pass
+        with pytest.raises(Overloaded):
+            with quotas.hold("a", 1):
+                pass
+    with quotas.hold("a", 1):
+        pass
+
+
+async def test_graph_rejects_oversized_state_without_calling_the_model() -> None:
+    res = await graph.ainvoke(
+        {"changeme": "x" * 1000}, context={"max_state_bytes": 100}
+    )
+    assert res["metadata"] == {
+        "outcome": "rejected",
+        "reason": "state_bytes",
+        "errors": None,
+    }
+    assert res["turns"] == 0
+
+
+async def test_middleware_answers_fast_when_saturated(
+    monkeypatch: pytest.MonkeyPatch,
+) -> None:
+    saturated = AdmissionController(1, max_queue=0)
+    saturated.inflight = 1
+    monkeypatch.setattr(admission, "controller", saturated)
+    sent: List[Dict[str, Any]] = []
+
+    async def app(scope: Any, receive: Any, send: Any) -> None:
+        raise AssertionError("request should not reach the server")
+
+    async def send(message: Dict[str, Any]) -> None:
+        sent.append(message)
+
+    middleware = admission.AdmissionMiddleware(app, max_body_bytes=10)
+    scope = {"type": "http", "method": "POST", "path": "/threads/t1/runs/wait"}
+    await middleware(scope, None, send)
+    assert sent[0]["status"] == 429
+    assert (b"retry-after", b"1") in sent[0]["headers"]
+
+    sent.clear()
+    big = {**scope, "headers": [(b"content-length", b"11")]}
+    await middleware(big, None, send)
+    assert sent[0]["status"] == 413
+
+    sent.clear()
+    bad = {**scope, "headers": [(b"content-length", b"1e3")]}
+    await middleware(bad, None, send)
+    assert sent[0]["status"] == 400
+
+
+async def test_middleware_counts_chunked_bodies(
+    monkeypatch: pytest.MonkeyPatch,
+) -> None:
+    monkeypatch.setattr(admission, "controller", AdmissionController(1))
+    sent: List[Dict[str, Any]] = []
+    seen: List[bytes] = []
+
+    async def app(scope: Any, receive: Any, send: Any) -> None:
+        message = await receive()
+        seen.append(message["body"])
+        assert not message["more_body"]
+
+    async def send(message: Dict[str, Any]) -> None:
+        sent.append(message)
+
+    def chunked(*chunks: bytes) -> Any:
+        messages = [
+            {"type": "http.request", "body": chunk, "more_body": True}
+            for chunk in chunks
+        ]
+        messages.append({"type": "http.request", "body": b"", "more_body": False})
+
+        async def receive() -> Dict[str, Any]:
+            return messages.pop(0)
+
+        return receive
+
+    middleware = admission.AdmissionMiddleware(app, max_body_bytes=10)
+    # No Content-Length: the size is only known by reading it.
+    scope = {"type": "http", "method": "POST", "path": "/threads/t1/runs/wait"}
+    await middleware(scope, chunked(b"123456", b"78901"), send)
+    assert sent[0]["status"] == 413 and not seen
+
+    sent.clear()
+    await middleware(scope, chunked(b"12345", b"67890"), send)
+    assert seen == [b"1234567890"] and not sent
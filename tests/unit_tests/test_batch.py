@@ -0,0 +1,78 @@
+import asyncio
+import json
+import random
+from pathlib import Path
+from typing import Any
+
+import pytest
+
+from agent.batch import run_batch
+
+pytestmark = pytest.mark.anyio
+
+
+class JitteryGraph:
+    checkpointer = None
+
+    def __init__(self) -> None:
+        self.inflight = 0
+        self.peak = 0
+
+    async def ainvoke(self, input: Any, config: Any, **kwargs: Any) -> Any:
+        self.inflight += 1
+        self.peak = max(self.peak, self.inflight)
+        await asyncio.sleep(random.random() / 1000)
+        self.inflight -= 1
+        if input["n"] == 3:
+            raise ValueError("bad row")
+        return {"n": input["n"] * 2}
+
+
+def _records(path: Path) -> list[Any]:
+    return [json.loads(line) for line in path.read_text().splitlines()]
+
+
+async def test_results_are_ordered_and_bounded(tmp_path: Path) -> None:
+    src, dst = tmp_path / "in.jsonl", tmp_path / "out.jsonl"
+    src.write_text("".join(json.dumps({"n": n}) + "\n" for n in range(200)))
+    graph = JitteryGraph()
+    assert await run_batch(graph, str(src), str(dst), concurrency=8) == 200
+    records = _records(dst)
+    assert [r["index"] for r in records] == list(range(200))
+    assert records[5]["output"] == {"n": 10}
+    assert "bad row" in records[3]["error"]
+    assert graph.peak <= 8
+
+
+async def test_resumes_after_a_torn_write(tmp_path: Path) -> None:
+    src, dst = tmp_path / "in.jsonl", tmp_path / "out.jsonl"
+    src.write_text("".join(json.dumps({"n": n}) + "\n" for n in range(10)))
+    await run_batch(JitteryGraph(), str(src), str(dst))
+    lines = dst.read_text().splitlines(keepends=True)
+    dst.write_text("".join(lines[:4]) + lines[4][:7])
+    assert await run_batch(JitteryGraph(), str(src), str(dst)) == 6
+    assert [r["index"] for r in _records(dst)] == list(range(10))
+
+
+class SavingGraph:
+    """Keeps each thread's history, like a graph with a checkpointer."""
+
+    checkpointer = object()
+
+    def __init__(self) -> None:
+        self.threads: dict[str, list[Any]] = {}
+
+    async def ainvoke(self, input: Any, config: Any, **kwargs: Any) -> Any:
+        history = self.threads.setdefault(config["configurable"]["thread_id"], [])
+        history.append(input["n"])
+        return {"history": list(history)}
+
+
+async def test_batches_do_not_share_threads(tmp_path: Path) -> None:
+    graph = SavingGraph()
+    for name in ("first", "second"):
+        src, dst = tmp_path / f"{name}.jsonl", tmp_path / f"{name}.out.jsonl"
+        src.write_text("".join(json.dumps({"n": n}) + "\n" for n in range(3)))
+        await run_batch(graph, str(src), str(dst))
+        assert [r["output"]["history"] for r in _records(dst)] == [[0], [1], [2]]
+    assert len(graph.threads) == 6
@@ -0,0 +1,34 @@
+import asyncio
+from typing import List, Sequence
+
+import pytest
+
+from agent.batching import MicroBatcher
+
+pytestmark = pytest.mark.anyio
+
+
+async def test_concurrent_submits_are_coalesced() -> None:
+    calls: List[List[int]] = []
+
+    async def double(items: Sequence[int]) -> List[int]:
+        calls.append(list(items))
+        return [i * 2 for i in items]
+
+    batcher = MicroBatcher(double, window=0.01, max_batch_size=3)
+    results = await asyncio.gather(*(batcher.submit(i) for i in range(5)))
+
+    assert results == [0, 2, 4, 6, 8]
+    assert calls == [[0, 1, 2], [3, 4]]
+
+
+async def test_batch_errors_propagate_to_every_caller() -> None:
+    async def fail(items: Sequence[int]) -> List[int]:
+        raise ValueError("boom")
+
+    batcher = MicroBatcher(fail, window=0.001, max_batch_size=8)
+    results = await asyncio.gather(
+        batcher.submit(1), batcher.submit(2), return_exceptions=True
+    )
+
+    assert all(isinstance(r, ValueError) for r in results)
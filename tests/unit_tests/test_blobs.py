@@ -0,0 +1,92 @@
+import os
+from pathlib import Path
+
+import pytest
+
+from agent.blobs import (
+    BlobRef,
+    LocalBlobStore,
+    is_blob_ref,
+    make_blob_store,
+    release,
+    resolve_text,
+)
+
+pytestmark = pytest.mark.anyio
+
+
+async def test_local_store_is_content_addressed(tmp_path: Path) -> None:
+    store = LocalBlobStore(str(tmp_path))
+    ref = await store.put(b"hello " * 1000)
+    assert ref == await store.put(b"hello " * 1000)
+    assert ref.size == 6000 and len(ref) < 100
+    assert bytes(await store.get(ref)) == b"hello " * 1000
+    # References survive as plain strings, e.g. after a JSON round trip.
+    assert is_blob_ref(str(ref))
+    assert await resolve_text(str(ref), store) == "hello " * 1000
+    assert await resolve_text("plain", store) == "plain"
+
+
+async def test_missing_blob_raises_key_error(tmp_path: Path) -> None:
+    store = LocalBlobStore(str(tmp_path))
+    with pytest.raises(KeyError):
+        await store.get(BlobRef.for_digest("0" * 64, 1))
+
+
+async def test_traversal_refs_are_rejected(tmp_path: Path) -> None:
+    secret = tmp_path / "secret.txt"
+    secret.write_text("do not serve")
+    store = LocalBlobStore(str(tmp_path / "blobs"))
+    crafted = f"blob:sha256:../../{secret}:1"
+
+    assert not is_blob_ref(crafted)
+    # Not a reference, so it stays plain text rather than being read.
+    assert await resolve_text(crafted, store) == crafted
+    with pytest.raises(ValueError):
+        BlobRef(crafted).digest
+    with pytest.raises(ValueError):
+        await store.get(crafted)
+    with pytest.raises(ValueError):
+        await store.get("blob:sha256:" + "A" * 64 + ":1")
+
+
+async def test_release_closes_the_mapping(tmp_path: Path) -> None:
+    store = LocalBlobStore(str(tmp_path))
+    data = await store.get(await store.put(b"mapped"))
+    mapping = data.obj
+    release(data)
+    assert mapping.closed
+
+
+async def test_sweep_deletes_only_unused_blobs(tmp_path: Path) -> None:
+    store = LocalBlobStore(str(tmp_path))
+    old, fresh = await store.put(b"old"), await store.put(b"fresh")
+    read = await store.put(b"read")
+    for ref in (old, read):
+        os.utime(store._path(ref.digest), (0, 0))
+    # Reading a blob counts as using it.
+    release(await store.get(read))
+    assert store.sweep(3600) == 1
+    with pytest.raises(KeyError):
+        await store.get(old)
+    for ref in (fresh, read):
+        release(await store.get(ref))
+    # Writing it again brings a swept blob back.
+    assert await store.put(b"old") == old
+    assert bytes(await store.get(old)) == b"old"
+
+
+async def test_default_store_is_under_the_data_dir(
+    tmp_path: Path, monkeypatch: pytest.MonkeyPatch
+) -> None:
+    monkeypatch.setenv("AGENT_DATA_DIR", str(tmp_path))
+    monkeypatch.chdir("/")
+    store = make_blob_store(None)
+    assert isinstance(store, LocalBlobStore)
+    assert store.root == str(tmp_path / "blobs")
+
+
+async def test_binary_blobs_stay_references(tmp_path: Path) -> None:
+    store = LocalBlobStore(str(tmp_path))
+    ref = await store.put(b"\x89PNG\r\n\x1a\n\xff")
+    assert await resolve_text(str(ref), store) == ref
@@ -0,0 +1,62 @@
+import asyncio
+
+import pytest
+
+from agent.cache import LRUCache, cache_key
+from agent.graph import State, response_key
+
+pytestmark = pytest.mark.anyio
+
+
+def test_cache_key_is_stable_and_ignores_execution_keys() -> None:
+    a = cache_key(State("hi"), {"my_configurable_param": "x", "max_batch_size": 4})
+    b = cache_key(
+        State("hi"),
+        {"max_batch_size": 8, "my_configurable_param": "x"},
+        ignore={"max_batch_size"},
+    )
+    c = cache_key(State("hi"), {"my_configurable_param": "x"})
+
+    assert b == c
+    assert a != c
+    assert cache_key(State("other"), {"my_configurable_param": "x"}) != c
+
+
+def test_response_key_ignores_run_metadata() -> None:
+    context = {"my_configurable_param": "x", "max_batch_size": 4}
+    timed = State("hi", metadata={"usage_total": {"runs": 3, "total_s": 0.2}})
+
+    assert response_key(timed, context) == response_key(State("hi"), context)
+    assert response_key(State("hi", turns=1), context) != response_key(
+        State("hi"), context
+    )
+
+
+async def test_lru_evicts_by_bytes_and_counts_hits() -> None:
+    cache = LRUCache(max_bytes=40)
+    await cache.set("a", {"v": "a" * 10})
+    await cache.set("b", {"v": "b" * 10})
+    assert await cache.get("a") is not None  # "a" is now most recently used
+    await cache.set("c", {"v": "c" * 10})
+
+    assert await cache.get("b") is None
+    assert await cache.get("a") == {"v": "a" * 10}
+    assert cache.size_bytes <= cache.max_bytes
+    assert cache.stats.hits == 2
+    assert cache.stats.misses == 1
+    assert cache.stats.evictions == 1
+
+
+async def test_lru_ttl_and_invalidation_hook() -> None:
+    cache = LRUCache()
+    invalidated = []
+    cache.on_invalidate(invalidated.append)
+
+    await cache.set("short", {"v": 1}, ttl=0.01)
+    await cache.set("long", {"v": 2})
+    await asyncio.sleep(0.02)
+    assert await cache.get("short") is None
+
+    await cache.invalidate("long")
+    assert await cache.get("long") is None
+    assert invalidated == ["long"]
@@ -0,0 +1,36 @@
+import pytest
+from langgraph.store.memory import InMemoryStore
+
+from agent.compaction import compact_history, extend_history, load_archive
+
+pytestmark = pytest.mark.anyio
+
+
+def test_extend_history_appends_and_drops() -> None:
+    assert extend_history(["a"], ["b", "c"]) == ["a", "b", "c"]
+    assert extend_history(["a", "b", "c"], {"drop": 2}) == ["c"]
+
+
+async def test_history_stays_bounded_and_archive_keeps_everything() -> None:
+    store = InMemoryStore()
+    context = {"history_max_bytes": 100, "history_keep": 2}
+    history: list[str] = []
+    summary, archived = "", 0
+    for turn in range(50):
+        history = extend_history(history, [f"turn {turn:02d}"])
+        update = await compact_history(
+            history, summary, archived, context, store, "t1"
+        )
+        if update:
+            history = extend_history(history, update["history"])
+            summary = update["summary"]
+            archived += update["archived"]
+        assert sum(len(e) for e in history) <= 100
+    archive = await load_archive(store, "t1")
+    assert archive + history == [f"turn {t:02d}" for t in range(50)]
+    assert archived == len(archive)
+
+
+async def test_under_budget_is_a_no_op() -> None:
+    update = await compact_history(["x"] * 3, "", 0, {}, None, None)
+    assert update == {}
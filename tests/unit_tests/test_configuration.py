@@ -1,9 +1,81 @@
+import asyncio
+import importlib
+import subprocess
+import sys
+import time
+import warnings
+from typing import Any, List
+
+import pytest
 from langgraph.pregel import Pregel
 
-from agent.graph import graph
+from agent.graph import Completion, fanout_graph, graph
+from agent.prompts import Usage
+
+graph_module = importlib.import_module("agent.graph")
 
 
 def test_placeholder() -> None:
     # TODO: You can add actual unit tests
     # for your graph and other logic here.
     assert isinstance(graph, Pregel)
+
+
+def test_package_import_is_lazy_and_keeps_the_submodule() -> None:
+    # Fresh interpreter, so nothing has imported agent.graph yet.
+    code = (
+        "import sys, agent\n"
+        "assert 'agent.graph' not in sys.modules\n"
+        "import agent.graph as g\n"
+        "from agent import graph\n"
+        "assert graph is g and g.State\n"
+        "assert 'agent.hedging' not in sys.modules\n"
+        "assert 'agent.semantic_cache' not in sys.modules\n"
+    )
+    subprocess.run([sys.executable, "-c", code], check=True)
+
+
+@pytest.mark.anyio
+async def test_old_package_import_still_runs_the_graph_with_a_warning() -> None:
+    from agent import graph as old_style
+
+    with warnings.catch_warnings(record=True) as caught:
+        warnings.simplefilter("always")
+        res = await old_style.ainvoke({"changeme": "x"})
+    assert res["turns"] == 1
+    assert caught and issubclass(caught[0].category, DeprecationWarning)
+
+
+@pytest.mark.anyio
+async def test_call_model_returns_deltas_for_reducer_fields() -> None:
+    res = await graph.ainvoke({"changeme": "x", "history": ["earlier"], "turns": 2})
+    assert res["history"] == ["earlier", res["changeme"]]
+    assert res["turns"] == 3
+
+
+@pytest.mark.anyio
+async def test_fanout_graph_gathers_results_in_input_order(
+    monkeypatch: pytest.MonkeyPatch,
+) -> None:
+    async def generate(requests: Any) -> List[Completion]:
+        # Later items finish first, so completing in order proves nothing.
+        (text, *_), *_ = requests
+        await asyncio.sleep({"a": 0.03, "b": 0.02, "c": 0.01}[text])
+        return [Completion(f"out-{text}", Usage())]
+
+    monkeypatch.setattr(graph_module, "generate", generate)
+    res = await fanout_graph.ainvoke(
+        {"items": ["a", "b", "c"]}, context={"fanout_max_concurrency": 3}
+    )
+    assert sorted(res["results"]) == [(0, "out-a"), (1, "out-b"), (2, "out-c")]
+    assert res["outputs"] == ["out-a", "out-b", "out-c"]
+
+
+@pytest.mark.anyio
+async def test_expired_deadline_reports_timeout_outcome() -> None:
+    res = await graph.ainvoke(
+        {"changeme": "x"}, context={"deadline_unix_s": time.time() - 1}
+    )
+    assert res["metadata"]["outcome"] == "timeout"
+    assert res["metadata"]["usage"]["source"] == "timeout"
+    assert res["changeme"] == "x"
@@ -0,0 +1,95 @@
+import asyncio
+from typing import Any, List, Mapping
+
+import pytest
+
+from agent import graph as graph_module
+from agent.accounting import ledger
+from agent.graph import Completion, graph
+from agent.hedging import Hedger, get_hedger
+from agent.prompts import Usage
+
+pytestmark = pytest.mark.anyio
+
+
+async def test_slow_primary_is_hedged_and_cancelled() -> None:
+    hedger = Hedger("model", percentile=50, max_ratio=1.0)
+    for _ in range(hedger.latency.min_samples):
+        hedger.latency.add(0.001)
+    hedger.stats.calls = 10
+    cancelled: List[str] = []
+
+    async def slow() -> str:
+        try:
+            await asyncio.sleep(1)
+        except asyncio.CancelledError:
+            cancelled.append("primary")
+            raise
+        return "primary"
+
+    async def fast() -> str:
+        return "hedge"
+
+    assert await hedger.call(slow, fast) == "hedge"
+    await asyncio.sleep(0)  # let the cancelled primary unwind
+    assert cancelled == ["primary"]
+    assert hedger.stats.hedges_fired == 1
+    assert hedger.stats.hedges_won == 1
+
+
+async def test_hedges_respect_the_budget() -> None:
+    hedger = Hedger("model", percentile=50, max_ratio=0.0)
+    for _ in range(hedger.latency.min_samples):
+        hedger.latency.add(0.001)
+
+    async def slow() -> str:
+        await asyncio.sleep(0.01)
+        return "primary"
+
+    async def never() -> str:
+        raise AssertionError("hedge should not fire")
+
+    assert await hedger.call(slow, never) == "primary"
+    assert hedger.stats.hedges_fired == 0
+
+
+async def test_hedged_call_reports_both_attempts(
+    monkeypatch: pytest.MonkeyPatch,
+) -> None:
+    hedger = get_hedger("hedge-usage", 50.0, 1.0)
+    for _ in range(hedger.latency.min_samples):
+        hedger.latency.add(0.001)
+    hedger.stats.calls = 10
+
+    async def run_model(
+        request: Any, context: Mapping[str, Any], writer: Any
+    ) -> Completion:
+        if context["model"] == "hedge-usage":
+            await asyncio.sleep(1)
+        return Completion("hedge", Usage(input_tokens=3, output_tokens=1))
+
+    monkeypatch.setattr(graph_module, "_run_model", run_model)
+    ledger.reset()
+    context = {
+        "model": "hedge-usage",
+        "hedge": True,
+        "hedge_percentile": 50.0,
+        "hedge_max_ratio": 1.0,
+        "hedge_model": "hedge-usage-b",
+        "usage_label": "hedge-test",
+    }
+    result = await graph.ainvoke({"changeme": "hedged"}, context=context)
+    metadata = result["metadata"]
+    assert metadata["usage"]["model"] == "hedge-usage-b"
+    (lost,) = metadata["usage_lost"]
+    assert lost["model"] == "hedge-usage" and lost["source"] == "hedge_loser"
+    assert metadata["usage_total"]["runs"] == 1
+    assert metadata["usage_total"]["lost_attempts"] == 1
+    rows = {r["model"]: r for r in ledger.snapshot() if r["label"] == "hedge-test"}
+    assert rows["hedge-usage"] == {
+        "label": "hedge-test",
+        "model": "hedge-usage",
+        "lost_attempts": 1,
+        "total_s": pytest.approx(lost["total_s"]),
+    }
+    assert rows["hedge-usage-b"]["runs"] == 1
@@ -0,0 +1,126 @@
+import asyncio
+from pathlib import Path
+from typing import Any, Dict, List
+
+import pytest
+
+from agent import jobqueue
+from agent.jobqueue import InteractiveReporter, JobQueue, WorkerPool
+
+pytestmark = pytest.mark.anyio
+
+
+async def test_claim_orders_by_priority_and_dedupes_keys() -> None:
+    queue = JobQueue(":memory:")
+    await queue.enqueue({"changeme": "low"}, {}, key="a")
+    await queue.enqueue({"changeme": "high"}, {"job_priority": 5}, key="b")
+    assert await queue.enqueue({"changeme": "again"}, {}, key="a") == "a"
+    jobs = await queue.claim(10)
+    assert [job.id for job in jobs] == ["b", "a"]
+    assert await queue.claim(10) == []
+
+
+async def test_expired_lease_is_redelivered_then_fails() -> None:
+    queue = JobQueue(":memory:", lease_s=-1, max_attempts=2)
+    await queue.enqueue({}, {}, key="j")
+    await queue.claim(1)
+    (second,) = await queue.claim(1)
+    assert second.attempts == 2
+    assert await queue.nack(second, "boom")
+    job = await queue.get("j")
+    assert job is not None and job["status"] == "failed"
+
+
+async def test_expired_last_attempt_fails_without_a_nack() -> None:
+    # The worker crashes on every delivery: nothing calls ack or nack.
+    queue = JobQueue(":memory:", lease_s=-1, max_attempts=2)
+    await queue.enqueue({}, {}, key="j")
+    assert len(await queue.claim(1)) == 1
+    assert len(await queue.claim(1)) == 1
+    assert await queue.claim(1) == []
+    job = await queue.get("j")
+    assert job is not None
+    assert job["status"] == "failed"
+    assert job["attempts"] == 2
+    assert job["error"] == "lease expired"
+
+
+async def test_stale_worker_cannot_ack_a_redelivered_job() -> None:
+    queue = JobQueue(":memory:", lease_s=-1, max_attempts=3)
+    await queue.enqueue({}, {}, key="j")
+    (stale,) = await queue.claim(1)
+    (current,) = await queue.claim(1)
+
+    assert not await queue.ack(stale, {"from": "stale"})
+    assert not await queue.nack(stale, "late")
+    job = await queue.get("j")
+    assert job is not None and job["status"] == "leased"
+
+    assert await queue.ack(current, {"from": "current"})
+    job = await queue.get("j")
+    assert job is not None and job["result"] == {"from": "current"}
+
+
+class EchoGraph:
+    checkpointer = None
+
+    def __init__(self) -> None:
+        self.calls: List[Dict[str, Any]] = []
+
+    async def ainvoke(self, input: Any, config: Any, *, context: Any) -> Any:
+        self.calls.append(context)
+        return {"changeme": input["changeme"].upper()}
+
+
+async def test_pool_drains_and_marks_runs_as_background() -> None:
+    queue = JobQueue(":memory:")
+    graph = EchoGraph()
+    for i in range(5):
+        await queue.enqueue({"changeme": f"x{i}"}, {}, key=str(i))
+    await WorkerPool(queue, {"agent": graph}, concurrency=2).drain()
+    job = await queue.get("3")
+    assert job is not None and job["result"] == {"changeme": "X3"}
+    assert len(graph.calls) == 5
+    assert all(call["background"] for call in graph.calls)
+
+
+async def test_unknown_assistant_fails_the_job_and_frees_its_slot() -> None:
+    queue = JobQueue(":memory:", max_attempts=3)
+    await queue.enqueue({"changeme": "x"}, {}, assistant="missing", key="bad")
+    await queue.enqueue({"changeme": "y"}, {}, key="good")
+    pool = WorkerPool(queue, {"agent": EchoGraph()}, concurrency=1)
+    await pool.drain()
+    bad = await queue.get("bad")
+    assert bad is not None and bad["status"] == "failed" and bad["attempts"] == 1
+    assert "missing" in bad["error"]
+    good = await queue.get("good")
+    assert good is not None and good["status"] == "done"
+    assert not pool._running
+
+
+async def test_pool_yields_to_interactive_calls_in_other_processes(
+    tmp_path: Path,
+) -> None:
+    path = str(tmp_path / "jobs.db")
+    server, worker = JobQueue(path), JobQueue(path)
+    await worker.enqueue({"changeme": "x"}, {}, key="bulk")
+    pool = WorkerPool(worker, {"agent": EchoGraph()}, yield_inflight=2)
+    pool.poll_interval = 0
+    await server.report_interactive("server-1", 2)
+    assert await pool.run_once() == 0
+    await server.withdraw_interactive("server-1")
+    assert await pool.run_once() == 1
+
+
+async def test_reporter_publishes_this_process_and_withdraws_on_stop(
+    monkeypatch: pytest.MonkeyPatch,
+) -> None:
+    queue = JobQueue(":memory:")
+    monkeypatch.setattr(jobqueue, "_interactive", 3)
+    reporter = InteractiveReporter(queue, interval=0.01)
+    await reporter.start()
+    await asyncio.sleep(0.03)
+    assert await queue.interactive_calls() == 3
+    assert await queue.interactive_calls(exclude=jobqueue.PROCESS) == 0
+    await reporter.stop()
+    assert await queue.interactive_calls() == 0
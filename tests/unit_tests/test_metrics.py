@@ -0,0 +1,66 @@
+import asyncio
+import json
+from dataclasses import asdict
+from typing import Any, Dict, List
+
+import pytest
+
+from agent import metrics
+from agent.graph import State
+
+pytestmark = pytest.mark.anyio
+
+SEP = (",", ":")
+
+
+class ListRecorder:
+    def __init__(self) -> None:
+        self.samples: List[metrics.NodeSample] = []
+        self.errors: List[str] = []
+
+    def record(self, sample: metrics.NodeSample) -> None:
+        self.samples.append(sample)
+
+    def record_error(self, node: str) -> None:
+        self.errors.append(node)
+
+    def observe(self, name: str, value: float, labels: Dict[str, str]) -> None:
+        pass
+
+    def increment(self, name: str, amount: float, labels: Dict[str, str]) -> None:
+        pass
+
+
+@pytest.fixture
+def recorder() -> Any:
+    rec = ListRecorder()
+    metrics.configure(rec, sample_rate=1.0)
+    yield rec
+    metrics.configure(metrics.NullRecorder(), sample_rate=0.0)
+
+
+async def test_instrument_records_wall_time_and_io_wait(recorder: Any) -> None:
+    async def slow_node(state: State) -> Dict[str, Any]:
+        await asyncio.sleep(0.02)
+        return {"changeme": "done"}
+
+    wrapped = metrics.instrument(slow_node)
+    assert wrapped.__name__ == "slow_node"
+    assert await wrapped(State("in")) == {"changeme": "done"}
+
+    (sample,) = recorder.samples
+    assert sample.node == "slow_node"
+    assert sample.wall_s >= 0.02
+    assert sample.io_wait_s >= 0.015
+    # Compact JSON of the whole State, all fields included.
+    assert sample.bytes_read == len(json.dumps(asdict(State("in")), separators=SEP))
+    assert sample.bytes_written == len('{"changeme":"done"}')
+
+
+async def test_instrument_counts_errors(recorder: Any) -> None:
+    async def broken(state: State) -> Dict[str, Any]:
+        raise RuntimeError("boom")
+
+    with pytest.raises(RuntimeError):
+        await metrics.instrument(broken)(State())
+    assert recorder.errors == ["broken"]
@@ -0,0 +1,65 @@
+import asyncio
+import contextvars
+import os
+import threading
+import time
+from typing import Tuple
+
+import pytest
+
+from agent.offload import LoopLagMonitor, cpu_bound, run_cpu
+
+pytestmark = pytest.mark.anyio
+
+request_id = contextvars.ContextVar("request_id", default="unset")
+
+
+@cpu_bound(processes=True)
+def square_in_child(x: int) -> Tuple[int, int]:
+    return os.getpid(), x * x
+
+
+async def test_run_cpu_keeps_the_loop_responsive() -> None:
+    monitor = LoopLagMonitor(interval=0.01)
+    monitor.start()
+    await asyncio.gather(*(run_cpu(time.sleep, 0.05) for _ in range(4)))
+    await monitor.stop()
+    assert monitor.max_lag < 0.04
+
+
+async def test_cpu_bound_runs_off_the_loop_thread() -> None:
+    @cpu_bound
+    def whoami(suffix: str) -> str:
+        return threading.current_thread().name + suffix
+
+    assert (await whoami("!")).startswith("agent-cpu")
+
+
+async def test_cpu_bound_processes_runs_the_undecorated_function() -> None:
+    # The module attribute is the wrapper; pickling `fn` itself would fail.
+    pid, square = await square_in_child(7)
+    assert square == 49
+    assert pid != os.getpid()
+
+
+def test_cpu_bound_processes_rejects_local_functions() -> None:
+    def local(x: int) -> int:
+        return x
+
+    with pytest.raises(TypeError, match="module-level"):
+        cpu_bound(processes=True)(local)
+
+
+async def test_threads_run_in_the_callers_context() -> None:
+    request_id.set("req-1")
+    assert await run_cpu(request_id.get) == "req-1"
+
+
+async def test_monitor_sees_a_blocked_loop() -> None:
+    monitor = LoopLagMonitor(interval=0.01)
+    monitor.start()
+    await asyncio.sleep(0.02)
+    time.sleep(0.1)
+    await asyncio.sleep(0.02)
+    await monitor.stop()
+    assert monitor.max_lag >= 0.05
@@ -0,0 +1,26 @@
+import pytest
+
+from agent.graph import graph
+from agent.prompts import build_request, cached_prefix
+
+pytestmark = pytest.mark.anyio
+
+
+def test_prefix_is_stable_across_inputs_and_params() -> None:
+    tools = [{"name": "b", "input_schema": {"y": 1, "x": 2}}, {"name": "a"}]
+    first = build_request("hi", "p1", tools=tools, cache_prefix=True)
+    second = build_request("bye", "p2", tools=tools[::-1], cache_prefix=True)
+    assert cached_prefix(first) == cached_prefix(second) is not None
+    assert [t["name"] for t in first["tools"]] == ["a", "b"]
+
+
+def test_no_breakpoint_without_cache_prefix() -> None:
+    assert cached_prefix(build_request("hi", None)) is None
+
+
+async def test_call_model_reports_cache_read_after_write() -> None:
+    context = {"my_configurable_param": "cached", "prompt_cache": True}
+    first = await graph.ainvoke({"changeme": "one"}, context=context)
+    second = await graph.ainvoke({"changeme": "two"}, context=context)
+    assert first["metadata"]["usage"]["output_tokens"] > 0
+    assert second["metadata"]["usage"]["cache_read_input_tokens"] > 0
@@ -0,0 +1,45 @@
+import asyncio
+
+import pytest
+
+from agent.racing import first_accepted, get_acceptor
+
+pytestmark = pytest.mark.anyio
+
+
+async def test_first_accepted_wins_and_losers_are_cancelled() -> None:
+    cancelled = []
+
+    async def branch(output: str, delay: float) -> str:
+        try:
+            await asyncio.sleep(delay)
+        except asyncio.CancelledError:
+            cancelled.append(output)
+            raise
+        return output
+
+    accept = get_acceptor("re:^good")
+    index, result = await first_accepted(
+        [
+            lambda: branch("bad fast", 0),
+            lambda: branch("good", 0.01),
+            lambda: branch("good slow", 1),
+        ],
+        accept,
+    )
+    assert (index, result) == (1, "good")
+    await asyncio.sleep(0)
+    assert cancelled == ["good slow"]
+
+
+async def test_falls_back_to_first_success_when_nothing_is_accepted() -> None:
+    async def fail() -> str:
+        raise RuntimeError("down")
+
+    async def empty() -> str:
+        return " "
+
+    index, result = await first_accepted([fail, empty], get_acceptor("nonempty"))
+    assert (index, result) == (1, " ")
+    with pytest.raises(RuntimeError):
+        await first_accepted([fail], get_acceptor("any"))
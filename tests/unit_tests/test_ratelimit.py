@@ -0,0 +1,63 @@
+import asyncio
+import time
+
+import pytest
+
+from agent.ratelimit import (
+    AIMDWindow,
+    LimiterConfig,
+    ModelLimiter,
+    ThrottledError,
+    TokenBucket,
+)
+
+pytestmark = pytest.mark.anyio
+
+
+async def test_token_bucket_limits_sustained_rate() -> None:
+    bucket = TokenBucket(rate=100, burst=5)
+    start = time.monotonic()
+    for _ in range(15):
+        await bucket.acquire()
+    # 5 tokens are available immediately, the other 10 take ~0.1s at 100/s.
+    assert time.monotonic() - start >= 0.09
+
+
+async def test_window_caps_concurrency() -> None:
+    window = AIMDWindow(initial=2, minimum=1, maximum=8)
+    peak = 0
+
+    async def call() -> None:
+        nonlocal peak
+        await window.acquire()
+        peak = max(peak, window.inflight)
+        await asyncio.sleep(0.005)
+        window.release()
+
+    await asyncio.gather(*(call() for _ in range(10)))
+    assert peak == 2
+    assert window.inflight == 0
+
+
+async def test_limiter_grows_on_success_and_halves_on_throttle() -> None:
+    limiter = ModelLimiter("key", "model", LimiterConfig(max_concurrency=16))
+    start = limiter.window.limit
+    for _ in range(20):
+        async with limiter.slot():
+            pass
+    grown = limiter.window.limit
+    assert grown > start
+
+    with pytest.raises(ThrottledError):
+        async with limiter.slot():
+            raise ThrottledError()
+    assert limiter.window.limit == pytest.approx(grown / 2)
+
+
+def test_limits_are_split_across_worker_processes(
+    monkeypatch: pytest.MonkeyPatch,
+) -> None:
+    monkeypatch.setenv("AGENT_WORKER_COUNT", "4")
+    limiter = ModelLimiter("key", "model", LimiterConfig(rps=8, max_concurrency=16))
+    assert limiter.bucket is not None and limiter.bucket.rate == 2
+    assert limiter.window.maximum == 4
@@ -0,0 +1,24 @@
+import sys
+
+import pytest
+
+from agent import resources
+
+pytestmark = pytest.mark.anyio
+
+
+async def test_http_client_is_shared_until_shutdown() -> None:
+    await resources.startup()
+    client = resources.get_http_client()
+    assert resources.get_http_client() is client
+
+    await resources.shutdown()
+    assert client.is_closed
+    assert resources.get_http_client() is not client
+    await resources.shutdown()
+
+
+def test_http2_needs_an_importable_h2(monkeypatch: pytest.MonkeyPatch) -> None:
+    # A None entry makes `import h2` raise ImportError, as a broken install would.
+    monkeypatch.setitem(sys.modules, "h2", None)
+    assert not resources._h2_available()
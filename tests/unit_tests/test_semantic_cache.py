@@ -0,0 +1,90 @@
+import random
+from pathlib import Path
+
+import pytest
+
+from agent.graph import graph
+from agent.semantic_cache import HNSWIndex, SemanticCache
+
+pytestmark = pytest.mark.anyio
+
+
+def test_hnsw_finds_nearest_neighbour() -> None:
+    rng = random.Random(0)
+    index = HNSWIndex()
+    vectors = []
+    for i in range(500):
+        v = [rng.gauss(0, 1) for _ in range(16)]
+        norm = sum(x * x for x in v) ** 0.5
+        vectors.append([x / norm for x in v])
+        index.add(vectors[-1], i)
+
+    hits = sum(index.search(vectors[i], k=1)[0][1] == i for i in range(0, 500, 10))
+    assert hits >= 48
+
+
+async def test_near_duplicates_hit_within_a_namespace() -> None:
+    cache = SemanticCache(threshold=0.8)
+    await cache.set("ns", "What is the capital of France?", {"changeme": "Paris"})
+
+    assert await cache.get("ns", "what is the capital of france") == {
+        "changeme": "Paris"
+    }
+    assert await cache.get("ns", "How do I bake sourdough bread?") is None
+    assert await cache.get("other", "What is the capital of France?") is None
+    assert cache.stats.hits == 1
+    assert cache.stats.misses == 2
+
+
+async def test_least_recently_used_namespace_is_dropped() -> None:
+    cache = SemanticCache(max_namespaces=2)
+    await cache.set("a", "hello", {"changeme": "a"})
+    await cache.set("b", "hello", {"changeme": "b"})
+    assert await cache.get("a", "hello") is not None  # "a" is now most recent
+    await cache.set("c", "hello", {"changeme": "c"})
+
+    assert len(cache) == 2
+    assert await cache.get("b", "hello") is None
+    assert await cache.get("a", "hello") == {"changeme": "a"}
+    assert cache.stats.evictions == 1
+
+
+async def test_namespace_ignores_thread_state() -> None:
+    context = {"my_configurable_param": "sem-ns", "semantic_cache": True}
+    await graph.ainvoke({"changeme": "Tell me about otters"}, context=context)
+    later_turn = {
+        "changeme": "tell me about  otters",
+        "history": ["earlier"],
+        "turns": 4,
+        "metadata": {"usage_total": {"runs": 4}},
+    }
+    res = await graph.ainvoke(later_turn, context=context)
+    assert res["metadata"]["usage"]["source"] == "semantic"
+
+
+async def test_full_namespace_is_rebuilt_off_the_loop() -> None:
+    cache = SemanticCache(max_entries=20)
+    for i in range(20):
+        await cache.set("ns", f"question number {i}", {"changeme": str(i)})
+    # The rebuild hasn't been swapped in yet; inserts and lookups carry on.
+    await cache.set("ns", "one more question", {"changeme": "late"})
+    assert await cache.get("ns", "one more question") == {"changeme": "late"}
+    await cache.flush()
+    assert await cache.get("ns", "question number 0", threshold=0.99) is None
+    assert await cache.get("ns", "question number 19") == {"changeme": "19"}
+    assert await cache.get("ns", "one more question") == {"changeme": "late"}
+    assert cache.stats.evictions == 10
+
+
+async def test_snapshot_survives_a_restart(tmp_path: Path) -> None:
+    path = str(tmp_path / "semantic.json")
+    cache = SemanticCache()
+    await cache.set("ns", "What is the capital of France?", {"changeme": "Paris"})
+    await cache.save(path)
+
+    restarted = SemanticCache()
+    await restarted.load(path)
+    await restarted.load(str(tmp_path / "missing.json"))
+    assert await restarted.get("ns", "what is the capital of france") == {
+        "changeme": "Paris"
+    }
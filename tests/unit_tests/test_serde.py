@@ -0,0 +1,32 @@
+from langgraph.checkpoint.serde.jsonplus import JsonPlusSerializer
+
+from agent.serde import CompactSerializer
+
+# What a checkpointer passes for the `agent` graph: one value per channel.
+CHANNEL_VALUES = {
+    "changeme": "abc " * 1000,
+    "history": [f"turn {i} " * 20 for i in range(100)],
+    "turns": 100,
+    "metadata": {"outcome": "ok"},
+}
+
+
+def test_large_channel_values_are_compressed() -> None:
+    serde = CompactSerializer(compress_threshold=1024)
+    default = JsonPlusSerializer()
+
+    for value in CHANNEL_VALUES.values():
+        tag, data = serde.dumps_typed(value)
+        plain_tag, plain = default.dumps_typed(value)
+        if len(plain) >= 1024:
+            assert tag.startswith(f"{plain_tag}+")
+            assert len(data) < len(plain)
+        else:
+            assert (tag, data) == (plain_tag, plain)
+        assert serde.loads_typed((tag, data)) == value
+
+
+def test_uncompressed_values_load_with_the_default_serializer() -> None:
+    serde = CompactSerializer()
+    encoded = serde.dumps_typed({"k": [1, 2]})
+    assert JsonPlusSerializer().loads_typed(encoded) == {"k": [1, 2]}
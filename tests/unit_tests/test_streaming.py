@@ -0,0 +1,45 @@
+import asyncio
+from contextlib import aclosing
+from typing import AsyncIterator, List
+
+import pytest
+
+from agent.streaming import bounded_stream
+
+pytestmark = pytest.mark.anyio
+
+
+async def test_reads_at_most_maxsize_ahead() -> None:
+    produced: List[int] = []
+
+    async def source() -> AsyncIterator[int]:
+        for i in range(100):
+            produced.append(i)
+            yield i
+
+    stream = bounded_stream(source(), maxsize=4)
+    assert await stream.__anext__() == 0
+    await asyncio.sleep(0.01)
+    # One yielded, four queued, one blocked in put().
+    assert len(produced) <= 6
+    await stream.aclose()
+
+
+async def test_early_exit_cancels_producer_and_closes_source() -> None:
+    closed = asyncio.Event()
+
+    async def source() -> AsyncIterator[int]:
+        try:
+            i = 0
+            while True:
+                yield i
+                i += 1
+        finally:
+            closed.set()
+
+    async with aclosing(bounded_stream(source(), maxsize=2)) as stream:
+        async for item in stream:
+            if item == 3:
+                break
+    assert closed.is_set()
+    assert not [t for t in asyncio.all_tasks() if t is not asyncio.current_task()]
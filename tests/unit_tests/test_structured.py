@@ -0,0 +1,90 @@
+import json
+from typing import Any, List
+
+import pytest
+
+from agent.graph import graph
+from agent.structured import FieldParser
+
+pytestmark = pytest.mark.anyio
+
+SCHEMA = {
+    "type": "object",
+    "properties": {"title": {"type": "string"}, "score": {"type": "number"}},
+    "required": ["title", "score"],
+}
+
+
+def test_fields_complete_as_soon_as_their_value_closes() -> None:
+    parser = FieldParser(SCHEMA)
+    assert parser.feed('```json\n{"title": "a, \\"b\\" }') == []
+    assert parser.feed('", "tags": [1, {"x": "]"}') == [("title", 'a, "b" }')]
+    assert parser.feed('], "score": 4') == [("tags", [1, {"x": "]"}])]
+    # A number may still continue until the next delimiter.
+    assert parser.feed("2}") == [("score", 42)]
+    parser.close()
+    assert parser.done and parser.errors == []
+
+
+def test_type_and_required_errors_are_collected() -> None:
+    parser = FieldParser(SCHEMA)
+    parser.feed('{"score": true')
+    parser.close()
+    assert parser.errors == [
+        "output is not a complete JSON object",
+        "missing required fields: ['title', 'score']",
+    ]
+    parser = FieldParser(SCHEMA)
+    parser.feed('{"title": "t", "score": "high"}')
+    parser.close()
+    assert parser.errors == ["score: expected number, got 'high'"]
+
+
+def test_long_output_fed_in_small_chunks_keeps_only_the_open_value() -> None:
+    obj = {f"k{i}": [i, {"s": "x" * 50}] for i in range(200)}
+    obj["title"], obj["score"] = "t" * 5000, 1.5
+    text = json.dumps(obj)
+    parser = FieldParser(SCHEMA)
+    completed = []
+    retained = 0
+    for i in range(0, len(text), 7):
+        completed += parser.feed(text[i : i + 7])
+        retained = max(retained, sum(map(len, parser._chunks)))
+    parser.close()
+    assert dict(completed) == obj and parser.errors == []
+    assert retained < len(obj["title"]) + 20
+
+
+async def test_streamed_fields_reach_the_client_and_state() -> None:
+    context = {"output_schema": SCHEMA, "stream": True}
+    events: List[Any] = []
+    async for mode, event in graph.astream(
+        {"changeme": "x"}, context=context, stream_mode=["custom", "values"]
+    ):
+        events.append((mode, event))
+    custom = [e for mode, e in events if mode == "custom"]
+    assert [e["field"] for e in custom if "field" in e] == ["title", "score"]
+    # "title" is emitted before the rest of the object has streamed.
+    first_field = next(i for i, e in enumerate(custom) if "field" in e)
+    assert any("chunk" in e for e in custom[first_field + 1 :])
+    final = [e for mode, e in events if mode == "values"][-1]
+    assert final["fields"] == json.loads(final["changeme"])
+    assert final["metadata"]["outcome"] == "ok"
+
+
+async def test_each_turn_replaces_fields_and_outcome_details() -> None:
+    earlier = {
+        "changeme": "x",
+        "fields": {"title": "old"},
+        "metadata": {"outcome": "invalid", "errors": ["score: missing"]},
+    }
+    res = await graph.ainvoke(earlier)
+    assert res["fields"] == {}
+    assert res["metadata"]["outcome"] == "ok"
+    assert res["metadata"]["errors"] is None
+    res = await graph.ainvoke(
+        {**earlier, "metadata": {"outcome": "rejected", "reason": "quota"}},
+        context={"output_schema": SCHEMA},
+    )
+    assert set(res["fields"]) == {"title", "score"}
+    assert res["metadata"]["reason"] is None
@@ -0,0 +1,95 @@
+import importlib
+import json
+from pathlib import Path
+from types import SimpleNamespace
+from typing import Any, List
+
+import pytest
+
+from agent import resources, warmup
+from agent.graph import graph
+
+pytestmark = pytest.mark.anyio
+
+graph_module = importlib.import_module("agent.graph")
+
+
+def test_spec_rejects_unknown_keys(tmp_path: Path) -> None:
+    path = tmp_path / "warmup.json"
+    path.write_text(json.dumps({"graphs": [], "invocatons": []}))
+    with pytest.raises(ValueError, match="invocatons"):
+        warmup.WarmupSpec.load(str(path))
+
+
+async def test_warm_up_preloads_cache_and_reports_failures(tmp_path: Path) -> None:
+    context = {"my_configurable_param": "warm", "response_cache": True}
+    (tmp_path / "hot.jsonl").write_text(
+        json.dumps({"input": {"changeme": "hot"}, "context": context, "output": "ok"})
+        + "\n"
+    )
+    path = tmp_path / "warmup.json"
+    path.write_text(
+        json.dumps(
+            {
+                "graphs": ["graph", "missing_graph"],
+                "cache": "hot.jsonl",
+                "invocations": [{"input": {"changeme": "synthetic"}}],
+            }
+        )
+    )
+    report = await warmup.warm_up(warmup.WarmupSpec.load(str(path)))
+    assert report["ready"] and warmup.status["ready"]
+    assert report["graphs"] == 1
+    assert report["cache_entries"] == 1
+    assert report["invocations"] == 1
+    assert report["errors"] and "missing_graph" in report["errors"][0]
+
+    res = await graph.ainvoke({"changeme": "hot"}, context=context)
+    assert res["changeme"] == "ok"
+    assert res["metadata"]["usage"]["source"] == "exact"
+
+
+def test_install_reports_a_spec_that_fails_to_load(
+    tmp_path: Path, monkeypatch: pytest.MonkeyPatch
+) -> None:
+    monkeypatch.setenv("AGENT_WARMUP", str(tmp_path / "missing.json"))
+    monkeypatch.setattr(warmup, "_installed", False)
+    monkeypatch.setattr(warmup, "status", {"ready": False})
+    warmup.install()
+    assert warmup.status["ready"]
+    assert "AGENT_WARMUP" in warmup.status["errors"][0]
+
+
+async def test_each_warm_up_uses_new_threads(monkeypatch: pytest.MonkeyPatch) -> None:
+    thread_ids = []
+
+    class Checkpointed:
+        checkpointer = object()
+
+        async def ainvoke(self, input: object, config: dict, **kwargs: object) -> None:
+            thread_ids.append(config["configurable"]["thread_id"])
+
+    monkeypatch.setattr(graph_module, "graph", Checkpointed())
+    spec = warmup.WarmupSpec(graphs=[], invocations=[{"input": {}}, {"input": {}}])
+    await warmup.warm_up(spec)
+    await warmup.warm_up(spec)
+    assert len(set(thread_ids)) == 4
+
+
+
+def test_warm_up_is_registered_after_the_persistence_hooks(
+    monkeypatch: pytest.MonkeyPatch,
+) -> None:
+    hooks: List[Any] = []
+
+    def import_module(name: str) -> Any:
+        hooks.append(name)  # Where the module's own hooks would go.
+        return importlib.import_module(name)
+
+    monkeypatch.setattr(resources, "_startup_hooks", hooks)
+    fake_importlib = SimpleNamespace(import_module=import_module)
+    monkeypatch.setattr(warmup, "importlib", fake_importlib)
+    monkeypatch.setattr(warmup, "_installed", False)
+    monkeypatch.setenv("AGENT_WARMUP", "1")
+    warmup.install()
+    assert hooks[0] == "agent.persistence" and callable(hooks[-1])
@@ -0,0 +1,104 @@
+import asyncio
+import os
+import signal
+from typing import Any, Dict, List, Optional
+
+import pytest
+
+from agent import jobqueue, resources, workers
+from agent.workers import Supervisor
+
+pytestmark = pytest.mark.anyio
+
+
+class FakeProc:
+    def __init__(self, env: Dict[str, str], log: List[Any]) -> None:
+        self.env = env
+        self.log = log
+        self.returncode: Optional[int] = None
+
+    def poll(self) -> Optional[int]:
+        return self.returncode
+
+    def terminate(self) -> None:
+        self.log.append(("terminate", self.env["AGENT_WORKER_INDEX"]))
+
+    def wait(self, timeout: Optional[float] = None) -> int:
+        self.returncode = 0
+        return 0
+
+
+@pytest.fixture
+def spawned(monkeypatch: pytest.MonkeyPatch) -> List[Any]:
+    log: List[Any] = []
+
+    def popen(command: List[str], env: Dict[str, str]) -> FakeProc:
+        log.append(("spawn", env["AGENT_WORKER_INDEX"]))
+        return FakeProc(env, log)
+
+    monkeypatch.setattr(workers.subprocess, "Popen", popen)
+    monkeypatch.setattr(workers, "usable_cpus", lambda: [2, 3])
+    return log
+
+
+def test_workers_get_their_index_cpu_and_limit_share(spawned: List[Any]) -> None:
+    supervisor = Supervisor(3, shares=4)
+    envs = [supervisor._spawn(i).env for i in range(3)]
+    assert [env["AGENT_WORKER_CPU"] for env in envs] == ["2", "3", "2"]
+    assert {env["AGENT_WORKER_COUNT"] for env in envs} == {"4"}
+    assert Supervisor(3)._spawn(0).env["AGENT_WORKER_COUNT"] == "3"
+
+
+def test_rolling_restart_starts_each_replacement_before_draining(
+    spawned: List[Any],
+) -> None:
+    supervisor = Supervisor(2, pin=False)
+    supervisor.procs = {i: supervisor._spawn(i) for i in range(2)}
+    old = dict(supervisor.procs)
+    spawned.clear()
+
+    supervisor.rolling_restart()
+
+    assert spawned == [
+        ("spawn", "0"),
+        ("terminate", "0"),
+        ("spawn", "1"),
+        ("terminate", "1"),
+    ]
+    assert all(supervisor.procs[i] is not old[i] for i in range(2))
+    assert all(proc.returncode == 0 for proc in old.values())
+
+
+def test_install_counts_the_server_in_the_limit_split(
+    monkeypatch: pytest.MonkeyPatch,
+) -> None:
+    monkeypatch.setenv("AGENT_WORKERS", "3")
+    monkeypatch.setenv("AGENT_WORKER_COUNT", "1")
+    monkeypatch.setattr(resources, "on_startup", lambda hook: hook)
+    monkeypatch.setattr(resources, "on_shutdown", lambda hook: hook)
+    workers.install()
+    assert os.environ["AGENT_WORKER_COUNT"] == "4"
+
+
+async def test_child_runs_the_pool_until_sigterm(
+    monkeypatch: pytest.MonkeyPatch,
+) -> None:
+    events: List[Any] = []
+
+    class FakePool:
+        def start(self) -> None:
+            events.append("start")
+            # Delivered through the handler `_run_child` installs on the loop.
+            loop = asyncio.get_running_loop()
+            loop.call_later(0.01, os.kill, os.getpid(), signal.SIGTERM)
+
+        async def stop(self, grace: float = 0) -> None:
+            events.append(("stop", grace))
+
+    monkeypatch.setenv("AGENT_JOBQUEUE", "sqlite:///:memory:")
+    monkeypatch.setenv("AGENT_WORKER_NICE", "0")
+    monkeypatch.setenv("AGENT_WORKER_GRACE_S", "7")
+    monkeypatch.delenv("AGENT_WORKER_CPU", raising=False)
+    monkeypatch.setattr(jobqueue, "make_pool", lambda queue: FakePool())
+    await asyncio.wait_for(workers._run_child(), 5)
+    assert events == ["start", ("stop", 7.0)]